@@ -14,24 +14,180 @@
 void SysTick_Handler(void);
 void SVC_Handler(void);
 
+#if __sMAX_SYSCALL_PRIORITY == 0 || __sMAX_SYSCALL_PRIORITY >= 0xE0
+#error "__sMAX_SYSCALL_PRIORITY must be between 1 and 0xDF (BASEPRI 0 masks nothing, SysTick and SVC run at 0xE0)"
+#endif
+
+extern volatile sUBaseType_t _sCriticalNesting;
+
+#if __sUSE_CRITICAL_STATS == 1
+void _sCriticalStatsBegin(const char *file, sUBaseType_t line);
+void _sCriticalStatsEnd(void);
+#endif
+
 /**
- * @brief   Enter a critical section (disable IRQ interrupts).
- * @details Executes CPSID I. Only valid in privileged mode.
- *          Pairs with __sCriticalRegionEnd().
- * @note    A critical section must be kept as short as possible.
+ * @brief   Enter a critical section (mask the interrupts that can call the kernel).
+ * @details Raises BASEPRI to __sMAX_SYSCALL_PRIORITY, interrupts with a higher priority keep running.
+ *          ARMv6-M has no BASEPRI and executes CPSID I. Only valid in privileged mode.
+ *          Critical sections nest, each call pairs with one __sCriticalRegionEnd().
+ * @note    A critical section must be kept as short as possible, and must not yield.
  */
 __STATIC_FORCEINLINE__ void __sCriticalRegionBegin(void)
 {
+#if defined(__ARM_ARCH_6M__)
   __asm volatile("cpsid i" : : : "memory");
+#else
+  __asm volatile("msr basepri, %0\n\tisb\n\tdsb" : : "r"(__sMAX_SYSCALL_PRIORITY) : "memory");
+#endif
+  _sCriticalNesting++;
 }
 
 /**
- * @brief   Exit a critical section (enable IRQ interrupts).
- * @details Executes CPSIE I. Only valid in privileged mode.
+ * @brief   Exit a critical section.
+ * @details The interrupts are unmasked when the outermost critical section ends.
  */
 __STATIC_FORCEINLINE__ void __sCriticalRegionEnd(void)
 {
-  __asm volatile("cpsie i" : : : "memory");
+  if (--_sCriticalNesting == 0)
+  {
+#if __sUSE_CRITICAL_STATS == 1
+    _sCriticalStatsEnd();
+#endif
+#if defined(__ARM_ARCH_6M__)
+    __asm volatile("cpsie i" : : : "memory");
+#else
+    __asm volatile("msr basepri, %0" : : "r"(0) : "memory");
+#endif
+  }
+}
+
+#if __sUSE_CRITICAL_STATS == 1
+// the outermost critical region records its call site, the macro calls the function above (a macro is not expanded in its own body)
+#define __sCriticalRegionBegin()                              \
+  do                                                          \
+  {                                                           \
+    __sCriticalRegionBegin();                                 \
+    if (_sCriticalNesting == 1)                               \
+      _sCriticalStatsBegin(__FILE__, (sUBaseType_t)__LINE__); \
+  } while (0)
+#endif
+
+#if defined(__ARM_ARCH_6M__)
+extern volatile sUBaseType_t _sExclusivePrimask;
+
+/*
+ * ARMv6-M has no LDREX/STREX: the load masks interrupts and the store (or the clear)
+ * restores the previous mask, so the load-modify-store sequence can not be interrupted.
+ * The mask is saved in one variable, nothing can run between the load and the store.
+ */
+__STATIC_FORCEINLINE__ sUBaseType_t __sLoadExclusive(volatile sUBaseType_t *addr)
+{
+  sUBaseType_t primask;
+  __asm volatile("mrs %0, primask\n\tcpsid i" : "=r"(primask) : : "memory");
+  _sExclusivePrimask = primask;
+  return *addr;
+}
+
+__STATIC_FORCEINLINE__ sUBaseType_t __sStoreExclusive(volatile sUBaseType_t *addr, sUBaseType_t value)
+{
+  *addr = value;
+  __asm volatile("msr primask, %0" : : "r"(_sExclusivePrimask) : "memory");
+  return 0;
+}
+
+__STATIC_FORCEINLINE__ void __sClearExclusive(void)
+{
+  __asm volatile("msr primask, %0" : : "r"(_sExclusivePrimask) : "memory");
+}
+#else
+/**
+ * @brief   Load-exclusive of a 32-bit word (LDREX).
+ * @details Marks the address for a following __sStoreExclusive().
+ */
+__STATIC_FORCEINLINE__ sUBaseType_t __sLoadExclusive(volatile sUBaseType_t *addr)
+{
+  sUBaseType_t value;
+  __asm volatile("ldrex %0, [%1]" : "=r"(value) : "r"(addr) : "memory");
+  return value;
+}
+
+/**
+ * @brief   Store-exclusive of a 32-bit word (STREX).
+ * @return  0 if the value was stored, 1 if the exclusive access was lost
+ *          (an exception or another store happened since __sLoadExclusive()).
+ */
+__STATIC_FORCEINLINE__ sUBaseType_t __sStoreExclusive(volatile sUBaseType_t *addr, sUBaseType_t value)
+{
+  sUBaseType_t failed;
+  __asm volatile("strex %0, %2, [%1]" : "=&r"(failed) : "r"(addr), "r"(value) : "memory");
+  return failed;
+}
+
+/**
+ * @brief   Drop the exclusive access taken by __sLoadExclusive() (CLREX).
+ */
+__STATIC_FORCEINLINE__ void __sClearExclusive(void)
+{
+  __asm volatile("clrex" : : : "memory");
+}
+#endif
+
+/**
+ * @return  Index of the most significant set bit of x (x must not be 0).
+ * @details CLZ on ARMv7-M. ARMv6-M has no CLZ (gcc would call a libgcc loop), the highest bit
+ *          is spread to the right and looked up with a de Bruijn multiply (about 16 cycles on M0+).
+ */
+__STATIC_FORCEINLINE__ sUBaseType_t __sHighestBit(sUBaseType_t x)
+{
+#if defined(__ARM_ARCH_6M__)
+  static const uint8_t deBruijn[32] = {0, 9, 1, 10, 13, 21, 2, 29, 11, 14, 16, 18, 22, 25, 3, 30,
+                                       8, 12, 20, 28, 15, 17, 24, 7, 19, 27, 23, 6, 26, 5, 4, 31};
+  x |= x >> 1;
+  x |= x >> 2;
+  x |= x >> 4;
+  x |= x >> 8;
+  x |= x >> 16;
+  return deBruijn[(x * 0x07C4ACDDu) >> 27];
+#else
+  return 31u - (sUBaseType_t)__builtin_clz(x);
+#endif
+}
+
+/**
+ * @return  Index of the least significant set bit of x (x must not be 0).
+ * @details RBIT + CLZ on ARMv7-M, an isolated bit and a de Bruijn multiply on ARMv6-M (about 8 cycles on M0+).
+ */
+__STATIC_FORCEINLINE__ sUBaseType_t __sLowestBit(sUBaseType_t x)
+{
+#if defined(__ARM_ARCH_6M__)
+  static const uint8_t deBruijn[32] = {0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+                                       31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9};
+  return deBruijn[((x & (0u - x)) * 0x077CB531u) >> 27];
+#else
+  return (sUBaseType_t)__builtin_ctz(x);
+#endif
+}
+
+/**
+ * @return  sTrue if called from an exception handler (IPSR is not 0).
+ */
+__STATIC_FORCEINLINE__ sbool_t __sIsInterruptContext(void)
+{
+  sUBaseType_t ipsr;
+  __asm volatile("mrs %0, ipsr" : "=r"(ipsr));
+  return (sbool_t)(ipsr != 0);
+}
+
+/**
+ * @brief Sets the higherPriorityWoken flag of a FromISR API.
+ *
+ * The flag is only ever set (never cleared), so an ISR can pass the same flag to several
+ * calls and give it to sRTOSYieldFromISR at the end. It may be NULL.
+ */
+__STATIC_FORCEINLINE__ void __sReportWoken(sbool_t *higherPriorityWoken, sbool_t woken)
+{
+  if (woken && higherPriorityWoken != NULL)
+    *higherPriorityWoken = sTrue;
 }
 
 /**
@@ -62,9 +218,22 @@ sRTOS_StatusTypeDef sRTOSInit(sUBaseType_t BUS_FREQ);
 extern void sRTOSStartScheduler(void);
 
 /**
- * @return current tick counter.
+ * @return current tick counter (64-bit, monotonic).
+ *
+ * @note Lock-free: the two halves are read until the high word is stable,
+ *       interrupts are not masked.
+ */
+sTick_t sGetTick(void);
+
+/**
+ * @brief Deadline of a timeout of timeoutTicks starting at tick start.
+ *
+ * @note __sMAX_DELAY gives a deadline that is never reached.
  */
-sUBaseType_t sGetTick(void);
+__STATIC_FORCEINLINE__ sTick_t __sTickDeadline(sTick_t start, sUBaseType_t timeoutTicks)
+{
+  return (timeoutTicks == __sMAX_DELAY) ? sTICK_MAX : start + timeoutTicks;
+}
 
 /**
  * @brief Create a task.
@@ -72,7 +241,7 @@ sUBaseType_t sGetTick(void);
  * Allocates/initializes a TCB and stack, assigns priority, and inserts
  * the task into the ready list.
  *
- * @param task           Entry function (should never returns. If it does it returns to an infinit loop).
+ * @param task           Entry function (if it returns, the task is deleted as by sRTOSTaskDelete(NULL)).
  * @param name           Descriptive name (may be used for debug; can be NULL).
  * @param arg            Argument passed to task function.
  * @param stacksizeWords Stack depth in 32-bit words (not bytes).
@@ -106,12 +275,64 @@ sRTOS_StatusTypeDef sRTOSTaskCreate(
  */
 void sRTOSTaskUpdatePriority(sTaskHandle_t *taskHandle, sPriority_t priority);
 
+/**
+ * @brief Set the round-robin time slice of a task.
+ *
+ * @param taskHandle Task to modify; if NULL uses current task.
+ * @param ticks      Ticks the task runs before the next task of its priority
+ *                   (0: __sQUANTA, at most __sQUANTA_EXPIRED - 1).
+ *
+ * @return sRTOS_OK, or sRTOS_ERROR if ticks is too large.
+ */
+sRTOS_StatusTypeDef sRTOSTaskSetTimeSlice(sTaskHandle_t *taskHandle, sUBaseType_t ticks);
+
+/**
+ * @brief Limit a task to a CPU budget per period.
+ *
+ * SysTick charges each tick to the running task. When the budget of the period is used,
+ * the task is demoted to sPriorityIdle (sBudgetDemote) or suspended (sBudgetSuspend)
+ * until the period ends. A period starts at the first tick charged after the previous one
+ * ended, so unused budget is not carried over.
+ *
+ * @param taskHandle  Task to limit; if NULL uses current task.
+ * @param budgetTicks Ticks per period, 0 removes the budget.
+ * @param periodTicks Replenishment period in ticks (budgetTicks <= periodTicks).
+ * @param policy      What happens to the task when its budget is exhausted.
+ *
+ * @return sRTOS_OK, or sRTOS_ERROR if the budget is larger than the period,
+ *         or sBudgetSuspend is asked for a basic task.
+ *
+ * @note A demoted task keeps the priority it inherited from a lock.
+ * @note The budget is enforced at the tick, the task is switched out at once only with __sUSE_PREEMPTION.
+ * @note Requires __sUSE_CPU_BUDGETS to be set to 1.
+ */
+sRTOS_StatusTypeDef sRTOSTaskSetBudget(sTaskHandle_t *taskHandle, sUBaseType_t budgetTicks, sUBaseType_t periodTicks, sBudgetPolicy_t policy);
+
+/**
+ * @brief Set the CPU share of a task of the fair-share level.
+ *
+ * The tasks of __sFAIR_SHARE_PRIORITY are scheduled by virtual runtime: a task with
+ * twice the weight of another gets about twice its CPU time while both are ready.
+ * The weight is kept if the task moves to another priority and back.
+ *
+ * @param taskHandle Task to modify; if NULL uses current task.
+ * @param weight     1 to 255 (tasks start with __sFAIR_SHARE_DEFAULT_WEIGHT).
+ *
+ * @return sRTOS_OK, or sRTOS_ERROR if the weight is out of range.
+ *
+ * @note Requires __sUSE_FAIR_SHARE to be set to 1.
+ */
+sRTOS_StatusTypeDef sRTOSTaskSetWeight(sTaskHandle_t *taskHandle, sUBaseType_t weight);
+
 /**
  * @brief Stop (suspend) a task.
  *
  * @param taskHandle Task to suspend; if NULL uses current task.
  *
  * @note Stopping the running task triggers a yield.
+ * @note A task stopped while blocked on an object stays stopped when the object is given
+ *       or the task is notified, only sRTOSTaskResume makes it ready again. Queue sends
+ *       and receives skip it and wake the next waiter instead.
  * @warning Undefined behavior if the handle is invalid.
  */
 void sRTOSTaskStop(sTaskHandle_t *taskHandle);
@@ -128,19 +349,67 @@ void sRTOSTaskResume(sTaskHandle_t *taskHandle);
 /**
  * @brief Delete a task and free its resources.
  *
+ * The task is removed from the scheduler at once, its stack is freed later by the idle task.
+ * A task that returns from its function is deleted the same way.
+ *
  * @param taskHandle Task to delete; if NULL deletes current task.
  *
- * @note Deleting the running task triggers a yield.
- * @warning Undefined behavior if the handle is invalid. Do not use the handle after deletion.
+ * @note Deleting the running task triggers a yield. Deleting a deleted task does nothing.
+ * @note A task blocked on a semaphore, mutex, rwlock or queue leaves its wait list (and a lock
+ *       owner drops the priority it inherited from it). Locks the task owns are not released.
+ * @warning Undefined behavior if the handle is invalid. The handle can be used for a new
+ *          task once the idle task has run (its stackBase is then NULL).
  */
 void sRTOSTaskDelete(sTaskHandle_t *taskHandle);
 
+/**
+ * @brief Create a basic (run-to-completion) task.
+ *
+ * A basic task has no stack of its own: every activation calls taskFunc on the
+ * basic task stack shared by all basic tasks, and the task ends when it returns.
+ * It is scheduled with the other tasks of its priority, but it only preempts
+ * the basic tasks of a lower priority.
+ *
+ * @param taskFunc Function called on every activation (must not block or yield).
+ * @param name     Descriptive name.
+ * @param arg      Argument passed to taskFunc.
+ * @param priority Task priority.
+ * @param task     Basic task object (owned by the caller).
+ *
+ * @retval sRTOS_OK Task created, it is suspended until its first activation.
+ * @retval sRTOS_ERROR taskFunc is NULL or the priority is out of range.
+ *
+ * @note Requires __sUSE_BASIC_TASKS to be set to 1.
+ */
+sRTOS_StatusTypeDef sRTOSBasicTaskCreate(sTaskFunc_t taskFunc, char *name, void *arg, sPriority_t priority, sBasicTask_t *task);
+
+/**
+ * @brief Activate a basic task.
+ *
+ * @retval true The task is ready to run.
+ * @retval false The task is already active (the activation is lost).
+ *
+ * @note Yields if the task has a higher priority than the caller.
+ */
+sbool_t sRTOSBasicTaskActivate(sBasicTask_t *task);
+
+/**
+ * @brief Activate a basic task from an ISR or a timer callback.
+ *
+ * @param higherPriorityWoken Set to sTrue if a task of higher priority than the interrupted one was woken (may be NULL),
+ *                            pass it to sRTOSYieldFromISR.
+ *
+ * @note The task starts at the next tick, or when the ISR returns with sRTOSYieldFromISR.
+ */
+sbool_t sRTOSBasicTaskActivateFromISR(sBasicTask_t *task, sbool_t *higherPriorityWoken);
+
 /**
  * @brief Delay (sleep) the calling task.
  *
  * @param duration_ms Time in milliseconds to delay (converted to ticks).
  *
  * @note Only valid from task context.
+ * @note If the kernel heap is exhausted the task polls the tick (yielding) instead of sleeping.
  */
 void sRTOSTaskDelay(sUBaseType_t duration_ms);
 
@@ -156,6 +425,57 @@ __STATIC_FORCEINLINE__ void sRTOSTaskYield(void)
   __asm volatile("svc #0");
 }
 
+/**
+ * @brief Request a context switch when the interrupt returns.
+ *
+ * Pends PendSV (lowest priority), which runs the scheduler once every nested
+ * interrupt has returned: a task woken by the FromISR APIs runs at once instead
+ * of at the next tick, and an ISR that woke several tasks switches only once.
+ *
+ * @param higherPriorityWoken Flag set by the FromISR APIs called by the ISR, nothing is done if sFalse.
+ *
+ * @code
+ * void UART_IRQHandler(void)
+ * {
+ *   sbool_t woken = sFalse;
+ *   sRTOSQueueSendFromISR(&rxQueue, &byte, &woken);
+ *   sRTOSSemaphoreGiveFromISR(&rxDone, &woken);
+ *   sRTOSYieldFromISR(woken);
+ * }
+ * @endcode
+ *
+ * @note Does nothing if __sUSE_PREEMPTION is 0, the woken task runs at the next yield.
+ */
+__STATIC_FORCEINLINE__ void sRTOSYieldFromISR(sbool_t higherPriorityWoken)
+{
+#if __sUSE_PREEMPTION == 1
+  if (higherPriorityWoken)
+    *((volatile uint32_t *)0xE000ED04) = 1u << 28; // ICSR.PENDSVSET
+#else
+  (void)higherPriorityWoken;
+#endif
+}
+
+extern volatile sUBaseType_t _sIsTimerRunning;
+
+/**
+ * @brief Yield after a kernel call woke a task of higher priority than the caller.
+ *
+ * A task switches at once (SVC). An interrupt, or a timer callback (which runs in thread
+ * mode on the timer stack, outside of any task), must not: the switch is pended instead
+ * and happens when the interrupt returns, or by the scheduler run at the end of the callback.
+ */
+__STATIC_FORCEINLINE__ void __sYieldIfWoken(sbool_t woken)
+{
+  if (!woken)
+    return;
+
+  if (__sIsInterruptContext() || _sIsTimerRunning)
+    sRTOSYieldFromISR(sTrue);
+  else
+    sRTOSTaskYield();
+}
+
 /**
  * @brief Create a software timer.
  *
@@ -166,7 +486,7 @@ __STATIC_FORCEINLINE__ void sRTOSTaskYield(void)
  * @param timerHandle Timer handle.
  *
  * @retval sRTOS_OK Timer created.
- * @retval sRTOS_ERROR Failure (allocation/parameters).
+ * @retval sRTOS_ALLOCATION_FAILED The kernel heap is exhausted, the timer is created stopped.
  *
  * @note Can be created before or after scheduler start.
  */
@@ -193,19 +513,22 @@ void sRTOSTimerStop(sTimerHandle_t *timerHandle);
  *
  * @param timerHandle Timer to resume.
  *
+ * @retval sRTOS_OK The timer runs.
+ * @retval sRTOS_ALLOCATION_FAILED The kernel heap is exhausted, the timer stays stopped.
+ *
  * @note Resets, next expiry relative to now.
  *
  * @warning Undefined behavior if the handle is invalid.
  */
-void sRTOSTimerResume(sTimerHandle_t *timerHandle);
+sRTOS_StatusTypeDef sRTOSTimerResume(sTimerHandle_t *timerHandle);
 
 /**
  * @brief Delete a timer and free its resources.
  *
  * @param timerHandle Timer to delete.
  *
- * @warning Do NOT delete a timer while its callback is executing; doing
- *          so may cause use-after-free.
+ * @note    A timer may delete itself from its callback (callbacks run on
+ *          a shared stack), the handle must stay valid until it returns.
  * @warning Undefined behavior if the handle is invalid.
  */
 void sRTOSTimerDelete(sTimerHandle_t *timerHandle);
@@ -216,10 +539,40 @@ void sRTOSTimerDelete(sTimerHandle_t *timerHandle);
  * @param timerHandle Timer to modify.
  * @param period      New period in ticks.
  *
+ * @retval sRTOS_OK The timer runs with the new period.
+ * @retval sRTOS_ALLOCATION_FAILED The kernel heap is exhausted, the timer is stopped.
+ *
  * @note Takes effect for the next cycle.
  * @warning Undefined behavior if the handle is invalid.
  */
-void sRTOSTimerUpdatePeriod(sTimerHandle_t *timerHandle, sBaseType_t period);
+sRTOS_StatusTypeDef sRTOSTimerUpdatePeriod(sTimerHandle_t *timerHandle, sBaseType_t period);
+
+/**
+ * @brief Set the slack of a timer.
+ *
+ * A timer with slack may expire anywhere in [deadline, deadline + slack].
+ * It expires at the end of its window, unless another timeout expires
+ * inside the window first, in which case both are handled in the same pass.
+ * This merges nearby expirations into fewer timer wakeups.
+ *
+ * @param timerHandle Timer to modify.
+ * @param slackTicks  Tolerance in ticks (clamped to __sTIMER_MAX_SLACK, 0 = exact).
+ *
+ * @note Takes effect for the next cycle; periodic timers keep their nominal period.
+ */
+void sRTOSTimerSetSlack(sTimerHandle_t *timerHandle, sUBaseType_t slackTicks);
+
+/**
+ * @brief Read the timer coalescing statistics.
+ *
+ * @param stats Output: number of timer expiry passes, of timers merged
+ *              into another timer's pass and of expirations dropped because
+ *              the timer daemon queue was full.
+ *
+ * @note droppedExpiries stays 0 unless __sUSE_TIMER_DAEMON is set to 1; a non-zero
+ *       value means __sTIMER_QUEUE_LENGTH is too small.
+ */
+void sRTOSTimerGetStats(sTimerStats_t *stats);
 
 /**
  * @brief Convert milliseconds to RTOS ticks.
@@ -227,13 +580,56 @@ void sRTOSTimerUpdatePeriod(sTimerHandle_t *timerHandle, sBaseType_t period);
  * @param timeoutMS Milliseconds.
  * @return Ticks corresponding to timeoutMS.
  *
- * @note Rounds toward zero; ensure resolution suits timing requirements.
+ * @note Rounds up, so a delay is never shorter than requested
+ *       (at the 10ms setting 1..10ms is one tick, not zero).
  */
 __STATIC_FORCEINLINE__ sUBaseType_t srMS_TO_TICKS(sUBaseType_t timeoutMS)
 {
-  return timeoutMS * (__sRTOS_SENSIBILITY / 1000);
+  return (sUBaseType_t)(((uint64_t)timeoutMS * __sRTOS_SENSIBILITY + 999u) / 1000u);
 }
 
+/**
+ * @brief Allocates memory from the kernel heap.
+ *
+ * With __sUSE_KERNEL_HEAP set to 1 the heap is a TLSF allocator: allocation and free
+ * take a bounded time whatever the heap state. Otherwise the C library malloc is used.
+ *
+ * @param size Bytes to allocate.
+ *
+ * @return 8-byte aligned memory, or NULL if no free block is large enough.
+ *
+ * @note Safe from tasks, ISRs and inside critical regions (the interrupt mask is restored).
+ */
+void *sRTOSMalloc(sUBaseType_t size);
+
+/**
+ * @brief Returns memory allocated by sRTOSMalloc() to the kernel heap.
+ *
+ * @param ptr Memory to free, NULL is ignored.
+ */
+void sRTOSFree(void *ptr);
+
+/**
+ * @brief Adds a memory region to the kernel heap.
+ *
+ * @param start Start of the region (it is aligned to 8 bytes).
+ * @param size  Size of the region in bytes.
+ *
+ * @retval sRTOS_OK The region is used by the heap.
+ * @retval sRTOS_ERROR The region is too small, or __sUSE_KERNEL_HEAP is 0.
+ *
+ * @note Regions are never merged together, each one is managed as a separate block chain.
+ */
+sRTOS_StatusTypeDef sRTOSHeapAddRegion(void *start, sUBaseType_t size);
+
+/**
+ * @brief Reads the kernel heap statistics.
+ *
+ * @param stats Filled with the free bytes, the minimum ever free bytes, the largest
+ *              free block and the fragmentation (all 0 if __sUSE_KERNEL_HEAP is 0).
+ */
+void sRTOSHeapGetStats(sHeapStats_t *stats);
+
 /**
  * @brief Create (initialize) a counting semaphore.
  *
@@ -249,12 +645,23 @@ void sRTOSSemaphoreCreate(sSemaphore_t *sem, sBaseType_t n);
  *
  * @param sem Semaphore to give.
  *
- * @warning Does not yield automatically while waiting, unless quantum finishs.
+ * @note Lock-free (LDREX/STREX) when no task waits. Otherwise the unit is handed to the
+ *       oldest waiting task, and the caller yields if that task has a higher priority
+ *       (from an ISR or a timer callback the switch is pended until it returns).
  */
 void sRTOSSemaphoreGive(sSemaphore_t *sem);
 
 /**
- * @brief Take (decrement) a semaphore with timeout (non-cooperative wait).
+ * @brief Give (increment) a semaphore from an ISR.
+ *
+ * @param sem Semaphore to give.
+ * @param higherPriorityWoken Set to sTrue if a task of higher priority than the interrupted one was woken (may be NULL),
+ *                            pass it to sRTOSYieldFromISR.
+ */
+void sRTOSSemaphoreGiveFromISR(sSemaphore_t *sem, sbool_t *higherPriorityWoken);
+
+/**
+ * @brief Take (decrement) a semaphore with timeout.
  *
  * @param sem          Semaphore to take.
  * @param timeoutTicks Max ticks to wait (0 = poll).
@@ -262,12 +669,13 @@ void sRTOSSemaphoreGive(sSemaphore_t *sem);
  * @retval true Obtained before timeout.
  * @retval false Timeout occurred.
  *
- * @note Does not yield while waiting; uses busy/periodic check strategy.
+ * @note Lock-free (LDREX/STREX) when a unit is available, interrupts are not masked.
+ *       Otherwise the task blocks until a unit is handed to it or the timeout expires.
  */
 sbool_t sRTOSSemaphoreTake(sSemaphore_t *sem, sUBaseType_t timeoutTicks);
 
 /**
- * @brief Take a semaphore with cooperative waiting (yields while waiting).
+ * @brief Take a semaphore with cooperative waiting.
  *
  * @param sem          Semaphore to take.
  * @param timeoutTicks Max ticks to wait (0 = poll).
@@ -275,7 +683,8 @@ sbool_t sRTOSSemaphoreTake(sSemaphore_t *sem, sUBaseType_t timeoutTicks);
  * @retval true Obtained before timeout.
  * @retval false Timeout occurred.
  *
- * @note Suitable for longer waits; allows other tasks to run immedialty.
+ * @note Same as sRTOSSemaphoreTake(), kept for compatibility: a waiting task always
+ *       blocks, so other tasks run meanwhile.
  */
 sbool_t sRTOSSemaphoreCooperativeTake(sSemaphore_t *sem, sUBaseType_t timeoutTicks);
 
@@ -284,7 +693,10 @@ sbool_t sRTOSSemaphoreCooperativeTake(sSemaphore_t *sem, sUBaseType_t timeoutTic
  *
  * @param mux Pointer to mutex object.
  *
- * @note Mutex provides ownership semantics (priority inheritance unspecified).
+ * @note Mutex provides ownership semantics and priority inheritance: the owner runs at
+ *       the priority of the highest task blocked on it until it releases the mutex. A task
+ *       holding several mutexes (or write locks) keeps the inherited priority until it
+ *       releases the last of them.
  */
 void sRTOSMutexCreate(sMutex_t *mux);
 
@@ -296,7 +708,8 @@ void sRTOSMutexCreate(sMutex_t *mux);
  * @retval true Released and possibly unblocked a waiting task.
  * @retval false Calling task was not the owner or invalid handle.
  *
- * @note May cause a yield if a higher-priority task is blocked waiting for the mutex to release.
+ * @note Lock-free when no task waits. Otherwise ownership is handed to the oldest waiting
+ *       task, and the caller yields if it has a higher priority or loses an inherited priority.
  */
 sbool_t sRTOSMutexGive(sMutex_t *mux);
 
@@ -306,13 +719,16 @@ sbool_t sRTOSMutexGive(sMutex_t *mux);
  * @param mux Mutex to release.
  *
  * @retval true Released.
- * @retval false Invalid handle or not releasable.
+ * @retval false The mutex was not taken.
+ *
+ * @param higherPriorityWoken Set to sTrue if a task of higher priority than the interrupted one was woken (may be NULL),
+ *                            pass it to sRTOSYieldFromISR.
  *
  * @warning Ownership is not validated; use only where safe.
- * @note Does not yield; but the task waiting to the release of the mutex inherites MaxPriority
- * and will almost always run immediatly after the isr.
+ * @note Does not yield; the task woken by the release runs at the next tick, or when the ISR
+ *       returns with sRTOSYieldFromISR.
  */
-sbool_t sRTOSMutexGiveFromISR(sMutex_t *mux);
+sbool_t sRTOSMutexGiveFromISR(sMutex_t *mux, sbool_t *higherPriorityWoken);
 
 /**
  * @brief Acquire (take) a mutex.
@@ -323,17 +739,104 @@ sbool_t sRTOSMutexGiveFromISR(sMutex_t *mux);
  * @retval true Acquired; caller becomes owner.
  * @retval false Timeout or failure.
  *
- * @note May yield while waiting.
+ * @note Lock-free (LDREX/STREX) when the mutex is free. Otherwise the task blocks, and
+ *       the owner inherits its priority while it holds the mutex.
  * @warning Deadlock possible if not used with care.
  */
 sbool_t sRTOSMutexTake(sMutex_t *mux, sUBaseType_t timeoutTicks);
 
+/**
+ * @brief Create (initialize) a reader-writer lock.
+ *
+ * @param lock Pointer to the lock object.
+ *
+ * @note Must be called before any take/give operation.
+ */
+void sRTOSRwLockCreate(sRwLock_t *lock);
+
+/**
+ * @brief Acquire a reader-writer lock in shared (read) mode.
+ *
+ * Any number of readers may hold the lock at the same time. A reader blocks
+ * while a writer holds the lock or while a writer is waiting for it
+ * (writer preference, so writers are not starved by a stream of readers).
+ *
+ * @param lock         Lock to take.
+ * @param timeoutTicks Max ticks to wait (0 = poll, __sMAX_DELAY = wait forever).
+ *
+ * @retval true Acquired in shared mode.
+ * @retval false Timeout occurred.
+ *
+ * @note The calling task is removed from the ready list while it waits.
+ * @warning Not safe to call from an interrupt context.
+ */
+sbool_t sRTOSRwLockReadTake(sRwLock_t *lock, sUBaseType_t timeoutTicks);
+
+/**
+ * @brief Release a reader-writer lock held in shared (read) mode.
+ *
+ * @param lock Lock to release.
+ *
+ * @retval true Released; the last reader wakes the first waiting writer.
+ * @retval false The lock was not held in shared mode.
+ */
+sbool_t sRTOSRwLockReadGive(sRwLock_t *lock);
+
+/**
+ * @brief Acquire a reader-writer lock in exclusive (write) mode.
+ *
+ * While the writer is blocked, the task holding the lock for writing
+ * inherits its priority until it releases the lock.
+ *
+ * @param lock         Lock to take.
+ * @param timeoutTicks Max ticks to wait (0 = poll, __sMAX_DELAY = wait forever).
+ *
+ * @retval true Acquired; caller is the owner.
+ * @retval false Timeout occurred.
+ *
+ * @note The calling task is removed from the ready list while it waits.
+ * @warning Not safe to call from an interrupt context.
+ */
+sbool_t sRTOSRwLockWriteTake(sRwLock_t *lock, sUBaseType_t timeoutTicks);
+
+/**
+ * @brief Release a reader-writer lock held in exclusive (write) mode.
+ *
+ * @param lock Lock to release.
+ *
+ * @retval true Released; a waiting writer, or else all waiting readers, are woken.
+ * @retval false Calling task was not the owner.
+ *
+ * @note Drops any inherited priority once the task holds no other mutex or write lock,
+ *       and may yield if a higher-priority task was woken.
+ */
+sbool_t sRTOSRwLockWriteGive(sRwLock_t *lock);
+
+/**
+ * @brief Waits for a notification on one of the calling task's notification slots.
+ *
+ * Blocks the calling task until the slot has a pending notification or until the
+ * timeout period expires. The task is woken by the notifier, it does not poll.
+ *
+ * @param index Notification slot, lower than __sTASK_NOTIFICATION_SLOTS.
+ * @param clearOnExit If sTrue, the value is cleared and the slot emptied (binary semaphore, event flags).
+ *                    If sFalse, the value is decremented and the slot stays pending while it is
+ *                    not 0 (counting semaphore).
+ * @param timeoutTicks Maximum ticks to wait (__sMAX_DELAY waits forever, 0 does not wait).
+ *
+ * @return The slot value before it was cleared/decremented, 0 if the timeout expired.
+ *
+ * @note Intended to be called from task context.
+ * @warning Not safe to call from an interrupt context.
+ */
+sUBaseType_t sRTOSTaskNotifyTakeIndexed(sUBaseType_t index, sbool_t clearOnExit, sUBaseType_t timeoutTicks);
+
 /**
  * @brief Waits for a notification sent to the calling task.
  *
  * Blocks the calling task until a notification is received or until the timeout
  * period expires. When a notification is received, the associated message value
- * is returned to the caller.
+ * is returned to the caller. Same as sRTOSTaskNotifyTakeIndexed(0, sTrue, timeoutTicks).
  *
  * @return If no notification is received before the timeout expires, returns 0.
  *
@@ -342,12 +845,46 @@ sbool_t sRTOSMutexTake(sMutex_t *mux, sUBaseType_t timeoutTicks);
  */
 sUBaseType_t sRTOSTaskNotifyTake(sUBaseType_t timeoutTicks);
 
+/**
+ * @brief Updates a notification slot of a target task.
+ *
+ * The slot value is updated according to action, and the slot becomes pending.
+ * If the task is blocked in sRTOSTaskNotifyTakeIndexed() on this slot it is woken,
+ * and the caller yields if the woken task has a higher priority.
+ *
+ * @param taskToNotify Pointer to the handle of the task to notify. Must not be NULL.
+ * @param index Notification slot, lower than __sTASK_NOTIFICATION_SLOTS.
+ * @param message Value used by the action (ignored by sNotifyIncrement and sNotifyNoAction).
+ * @param action sNotifyNoAction, sNotifySetBits, sNotifyIncrement, sNotifyOverwrite or sNotifyOverwriteIfEmpty.
+ *
+ * @retval sTrue The notification was delivered.
+ * @retval sFalse The index is out of range, or the action is sNotifyOverwriteIfEmpty and
+ *                the slot still holds a pending notification.
+ *
+ * @note Intended to be called from task context.
+ * @warning Not safe to call from an interrupt context.
+ */
+sbool_t sRTOSTaskNotifyIndexed(sTaskHandle_t *taskToNotify, sUBaseType_t index, sUBaseType_t message, sNotifyAction_t action);
+
+/**
+ * @brief Updates a notification slot of a target task from an ISR.
+ *
+ * Same as sRTOSTaskNotifyIndexed() without yielding, the woken task runs at the next tick,
+ * or when the ISR returns with sRTOSYieldFromISR.
+ *
+ * @param higherPriorityWoken Set to sTrue if a task of higher priority than the interrupted one was woken (may be NULL),
+ *                            pass it to sRTOSYieldFromISR.
+ *
+ * @note Intended to be called from ISR context.
+ */
+sbool_t sRTOSTaskNotifyIndexedFromISR(sTaskHandle_t *taskToNotify, sUBaseType_t index, sUBaseType_t message, sNotifyAction_t action, sbool_t *higherPriorityWoken);
+
 /**
  * @brief Sends a notification with a message to a target task.
  *
  * Posts a notification to specified task, optionally waking it if it is
  * blocked waiting in sRTOSTaskNotifyTake(). The provided message value is
- * delivered to the receiving task.
+ * delivered to the receiving task (slot 0, sNotifyOverwrite).
  *
  * @param taskToNotify Pointer to the handle of the task to notify. Must not be NULL.
  * @param message uint32 value to deliver with the notification.
@@ -362,14 +899,16 @@ void sRTOSTaskNotify(sTaskHandle_t *taskToNotify, sUBaseType_t message);
  *
  * Posts a notification to the specified task, optionally waking it if it is
  * blocked waiting in sRTOSTaskNotifyTake(). The provided message value is
- * delivered to the receiving task.
+ * delivered to the receiving task (slot 0, sNotifyOverwrite).
  *
  * @param taskToNotify Pointer to the handle of the task to notify. Must not be NULL.
  * @param message uint32 value to deliver with the notification.
+ * @param higherPriorityWoken Set to sTrue if a task of higher priority than the interrupted one was woken (may be NULL),
+ *                            pass it to sRTOSYieldFromISR.
  *
  * @note Intended to be called from ISR context.
  */
-void sRTOSTaskNotifyFromISR(sTaskHandle_t *taskToNotify, sUBaseType_t message);
+void sRTOSTaskNotifyFromISR(sTaskHandle_t *taskToNotify, sUBaseType_t message, sbool_t *higherPriorityWoken);
 
 /**
  * @brief Creates/initializes a queue object.
@@ -382,9 +921,26 @@ void sRTOSTaskNotifyFromISR(sTaskHandle_t *taskToNotify, sUBaseType_t message);
  * @param queueLengh Number of items the queue can hold (capacity).
  * @param itemSize Size, in bytes, of each item stored in the queue.
  *
+ * @retval sRTOS_OK Queue created.
+ * @retval sRTOS_ALLOCATION_FAILED The kernel heap is exhausted, the queue is created with a length of 0
+ *                                 (every send and receive fails or times out).
+ *
  * @note This function must be called before sRTOSQueueSend() or sRTOSQueueReceive().
  */
-void sRTOSQueueCreate(sQueueHandle_t *queueHandle, sUBaseType_t queueLengh, sUBaseType_t itemSize);
+sRTOS_StatusTypeDef sRTOSQueueCreate(sQueueHandle_t *queueHandle, sUBaseType_t queueLengh, sUBaseType_t itemSize);
+
+/**
+ * @brief Creates/initializes a queue object on caller provided storage.
+ *
+ * Same as sRTOSQueueCreate() without any allocation (used by the objects generated
+ * by tools/sRTOSgen.py).
+ *
+ * @param queueHandle Pointer to the queue handle to initialize. Must not be NULL.
+ * @param queueLengh Number of items the queue can hold (capacity).
+ * @param itemSize Size, in bytes, of each item stored in the queue.
+ * @param storage Buffer of at least queueLengh * itemSize bytes.
+ */
+void sRTOSQueueCreateStatic(sQueueHandle_t *queueHandle, sUBaseType_t queueLengh, sUBaseType_t itemSize, uint8_t *storage);
 
 /**
  * @brief Receives (dequeues) an item from a queue.
@@ -424,20 +980,339 @@ sbool_t sRTOSQueueReceive(sQueueHandle_t *queueHandle, void *itemPtr, sUBaseType
 sbool_t sRTOSQueueSend(sQueueHandle_t *queueHandle, void *itemPtr, sUBaseType_t timeoutTicks);
 
 /**
- * @brief Sends (enqueues) an item to a queue.
- *
- * If the queue is full, this function blocks for up to timeoutTicks waiting for
- * space to become available.
+ * @brief Sends (enqueues) an item to a queue from an ISR, without waiting.
  *
  * @param queueHandle Pointer to the queue handle. Must reference a created queue.
  * @param itemPtr Pointer to the item data to send; the data at this address is copied
- * @param timeoutTicks Number of RTOS ticks to wait.
+ * @param higherPriorityWoken Set to sTrue if a task of higher priority than the interrupted one was woken (may be NULL),
+ *                            pass it to sRTOSYieldFromISR.
  *
  * @retval true The item was successfully enqueued.
- * @retval false if the queue is full or memory allocation failed.
+ * @retval false The queue is full.
+ *
+ * @note Intended to be called from ISR context.
+ */
+sbool_t sRTOSQueueSendFromISR(sQueueHandle_t *queueHandle, void *itemPtr, sbool_t *higherPriorityWoken);
+
+/**
+ * @brief Receives (dequeues) an item from a queue from an ISR, without waiting.
+ *
+ * @param queueHandle Pointer to the queue handle. Must reference a created queue.
+ * @param itemPtr Pointer to a buffer of the queue item size, the oldest item is copied to it.
+ * @param higherPriorityWoken Set to sTrue if a task of higher priority than the interrupted one was woken (may be NULL),
+ *                            pass it to sRTOSYieldFromISR.
+ *
+ * @retval true An item was received.
+ * @retval false The queue is empty.
  *
  * @note Intended to be called from ISR context.
  */
-sbool_t sRTOSQueueSendFromISR(sQueueHandle_t *queueHandle, void *itemPtr);
+sbool_t sRTOSQueueReceiveFromISR(sQueueHandle_t *queueHandle, void *itemPtr, sbool_t *higherPriorityWoken);
+
+/**
+ * @brief Defers work from an interrupt to the deferred work task.
+ *
+ * Appends func/arg to a lock-free ring and wakes the deferred work task,
+ * which calls the queued functions in the order they were deferred.
+ * Every function queued while the task runs is handled in the same batch.
+ *
+ * @param func Function to run in task context.
+ * @param arg  Argument passed to func.
+ * @param higherPriorityWoken Set to sTrue if a task of higher priority than the interrupted one was woken (may be NULL),
+ *                            pass it to sRTOSYieldFromISR.
+ *
+ * @retval true The work was queued.
+ * @retval false The ring is full (__sDEFERRED_QUEUE_LENGTH entries pending).
+ *
+ * @note Intended to be called from ISR context. Interrupts are masked only
+ *       while waking the task, the queue itself uses LDREX/STREX.
+ * @note Requires __sUSE_DEFERRED_WORK to be set to 1.
+ */
+sbool_t sRTOSDeferFromISR(sDeferredFunc_t func, void *arg, sbool_t *higherPriorityWoken);
+
+/**
+ * @brief Copy the scheduling latency histograms of a task.
+ *
+ * The wakeup histogram counts from the moment the kernel makes the task ready
+ * (timeout, resume, a give or notify from another task) until the task is switched in,
+ * the isrToTask histogram counts the same path when an interrupt made the task ready
+ * through a FromISR API. Latencies are in counts of the clock selected by __sLATENCY_CLOCK.
+ *
+ * @param task  Task to query.
+ * @param stats Output: histograms and worst cases.
+ *
+ * @note Requires __sUSE_LATENCY_STATS to be set to 1.
+ */
+void sRTOSLatencyGetStats(sTaskHandle_t *task, sLatencyStats_t *stats);
+
+/**
+ * @brief Clear the scheduling latency histograms of a task.
+ */
+void sRTOSLatencyReset(sTaskHandle_t *task);
+
+/**
+ * @brief Copy the critical region statistics.
+ *
+ * Every outermost critical region records how long it masked the interrupts and
+ * the file and line of its __sCriticalRegionBegin. The longest one and the
+ * __sCRITICAL_STATS_TOP call sites with the longest regions are kept.
+ * Durations are in counts of the clock selected by __sLATENCY_CLOCK.
+ *
+ * @param stats Output: statistics, top sorted longest first.
+ *
+ * @note The kernel handlers (SysTick, SVC) are not measured.
+ * @note Requires __sUSE_CRITICAL_STATS to be set to 1.
+ */
+void sRTOSCriticalGetStats(sCriticalStats_t *stats);
+
+/**
+ * @brief Clear the critical region statistics.
+ */
+void sRTOSCriticalResetStats(void);
+
+/**
+ * @brief Name a semaphore, mutex or queue in the object registry.
+ *
+ * The registry lets a monitor walk the objects with sRTOSObjectGetInfo. Objects count
+ * their statistics whether they are registered or not. Registering an object again
+ * changes its name.
+ *
+ * @param object The sSemaphore_t, sMutex_t or sQueueHandle_t.
+ * @param type   Type of the object.
+ * @param name   Name, not copied (it must outlive the registration).
+ *
+ * @retval sRTOS_OK The object is registered.
+ * @retval sRTOS_ERROR The registry is full (__sMAX_NAMED_OBJECTS) or the type is unknown.
+ *
+ * @note Requires __sUSE_OBJECT_STATS to be set to 1.
+ */
+sRTOS_StatusTypeDef sRTOSObjectRegister(void *object, sObjectType_t type, const char *name);
+
+/**
+ * @brief Remove an object from the registry, before the object goes out of scope.
+ */
+void sRTOSObjectUnregister(void *object);
+
+/**
+ * @brief Copy the registry entry at index, with the statistics of its object.
+ *
+ * Entries are kept in registration order, so index 0, 1, ... enumerates them
+ * until sFalse is returned.
+ *
+ * @param index Entry to read.
+ * @param info  Output: name, type, object and statistics.
+ *
+ * @retval true The entry exists.
+ * @retval false index is past the last entry.
+ */
+sbool_t sRTOSObjectGetInfo(sUBaseType_t index, sObjectInfo_t *info);
+
+/**
+ * @brief Copy the statistics of a semaphore, mutex or queue.
+ *
+ * Acquisitions are the successful takes (sends and receives for a queue), contended
+ * counts the calls that had to block and timeouts those of them that gave up.
+ * Wait times are in ticks. The queue high-water mark tells how much of its storage
+ * was ever used.
+ *
+ * @param object The sSemaphore_t, sMutex_t or sQueueHandle_t.
+ * @param type   Type of the object.
+ * @param stats  Output: counters of the object.
+ */
+void sRTOSObjectGetStats(void *object, sObjectType_t type, sObjectStats_t *stats);
+
+/**
+ * @brief Clear the statistics of an object (the high-water mark restarts from the current queue level).
+ */
+void sRTOSObjectResetStats(void *object, sObjectType_t type);
+
+/**
+ * @brief Set the major frame of the time partitions.
+ *
+ * The windows run in order and the major frame repeats. During a window only the tasks
+ * of its partition and of the system partition (0) can run; the priorities are kept
+ * inside the window, and at the same priority the window's partition runs first.
+ * The table is copied.
+ *
+ * @param windows Windows of the major frame.
+ * @param count   Number of windows (at most __sMAX_PARTITION_WINDOWS), 0 removes the schedule
+ *                and every partition can run at any time.
+ *
+ * @return sRTOS_OK, or sRTOS_ERROR if a window has no duration or an unknown partition.
+ *
+ * @note The windows are checked by the scheduler: a window ends at the next tick after its
+ *       duration, or at the next yield when __sUSE_PREEMPTION is 0.
+ * @note Requires __sUSE_PARTITIONS to be set to 1.
+ */
+sRTOS_StatusTypeDef sRTOSPartitionSetSchedule(const sPartitionWindow_t *windows, sUBaseType_t count);
+
+/**
+ * @brief Move a task to a time partition.
+ *
+ * @param taskHandle Task to move; if NULL uses current task.
+ * @param partition  Partition index (0 to __sPARTITION_COUNT - 1); tasks start in partition 0.
+ *
+ * @return sRTOS_OK, or sRTOS_ERROR if the partition does not exist or the task is a basic task
+ *         (basic tasks stay in the system partition).
+ *
+ * @note Moving the running task triggers a yield.
+ * @note Requires __sUSE_PARTITIONS to be set to 1.
+ */
+sRTOS_StatusTypeDef sRTOSTaskSetPartition(sTaskHandle_t *taskHandle, sUBaseType_t partition);
+
+/**
+ * @brief Create a stackless coroutine.
+ *
+ * The coroutine costs only its sCoroutine_t, every coroutine runs on the
+ * stack of the coroutine scheduler task. It competes with the tasks as if it
+ * were a task of the given priority, but it is never preempted by another coroutine.
+ *
+ * @param func     Body of the coroutine, written between sCO_BEGIN and sCO_END.
+ * @param arg      Argument passed to func.
+ * @param priority Coroutine priority (same range as the task priorities).
+ * @param co       Coroutine object (owned by the caller, valid while the coroutine runs).
+ *
+ * @retval sRTOS_OK Coroutine created and ready.
+ * @retval sRTOS_ERROR func is NULL or the priority is out of range.
+ *
+ * @note Call after sRTOSInit. Requires __sUSE_COROUTINES to be set to 1.
+ * @warning Local variables do not survive a wait, keep the state in arg or in static variables.
+ */
+sRTOS_StatusTypeDef sRTOSCoroutineCreate(sCoroutineFunc_t func, void *arg, sPriority_t priority, sCoroutine_t *co);
+
+/**
+ * @brief Notify a coroutine, it is woken if it waits in sCO_WAIT_NOTIFY.
+ *
+ * @param co      Coroutine to notify.
+ * @param message Value taken by sCO_WAIT_NOTIFY (overwrites a pending one).
+ *
+ * @note Yields if the coroutine now runs at a higher priority than the caller.
+ */
+void sRTOSCoroutineNotify(sCoroutine_t *co, sUBaseType_t message);
+
+/**
+ * @brief Notify a coroutine from an ISR.
+ *
+ * @param higherPriorityWoken Set to sTrue if a task of higher priority than the interrupted one was woken (may be NULL),
+ *                            pass it to sRTOSYieldFromISR.
+ *
+ * @note The woken coroutine runs at the next tick, or when the ISR returns with sRTOSYieldFromISR.
+ */
+void sRTOSCoroutineNotifyFromISR(sCoroutine_t *co, sUBaseType_t message, sbool_t *higherPriorityWoken);
+
+sbool_t _sCoroutineWait(sCoroutine_t *co, sUBaseType_t timeoutTicks, sbool_t notification);
+sUBaseType_t _sCoroutineTakeNotification(sCoroutine_t *co);
+
+/*
+ * Coroutine body (protothread style): a wait saves the line it is on as the
+ * continuation point and returns, the next run jumps back to it through the switch.
+ * Waits can only be used in the body itself (not in functions it calls), and not
+ * inside another switch statement.
+ *
+ *   void blink(sCoroutine_t *co, void *arg)
+ *   {
+ *     sCO_BEGIN(co);
+ *     for (;;)
+ *     {
+ *       toggleLed();
+ *       sCO_DELAY(co, 500);
+ *     }
+ *     sCO_END(co);
+ *   }
+ */
+#define sCO_BEGIN(co)        \
+  switch ((co)->resumePoint) \
+  {                          \
+  case 0:
+
+// the coroutine is finished, it is never run again
+#define sCO_END(co) \
+  }                 \
+  (co)->status = sDeleted
+
+// lets the other ready coroutines of the same priority run
+#define sCO_YIELD(co)             \
+  do                              \
+  {                               \
+    (co)->resumePoint = __LINE__; \
+    return;                       \
+  case __LINE__:;                 \
+  } while (0)
+
+// sleeps for duration_ms (runs on if the timeout can not be allocated)
+#define sCO_DELAY(co, duration_ms)                                 \
+  do                                                               \
+  {                                                                \
+    (co)->resumePoint = __LINE__;                                  \
+    if (_sCoroutineWait((co), srMS_TO_TICKS(duration_ms), sFalse)) \
+      return;                                                      \
+  case __LINE__:;                                                  \
+  } while (0)
+
+// waits until condition is true, it is checked once per tick
+#define sCO_WAIT_UNTIL(co, condition)   \
+  do                                    \
+  {                                     \
+    (co)->resumePoint = __LINE__;       \
+  case __LINE__:                        \
+    if (!(condition))                   \
+    {                                   \
+      _sCoroutineWait((co), 1, sFalse); \
+      return;                           \
+    }                                   \
+  } while (0)
+
+// waits up to timeoutTicks for sRTOSCoroutineNotify, value receives the message (0 on timeout)
+#define sCO_WAIT_NOTIFY(co, timeoutTicks, value)      \
+  do                                                  \
+  {                                                   \
+    (co)->resumePoint = __LINE__;                     \
+    if (_sCoroutineWait((co), (timeoutTicks), sTrue)) \
+      return;                                         \
+  case __LINE__:                                      \
+    (value) = _sCoroutineTakeNotification(co);        \
+  } while (0)
+
+/**
+ * @brief Initialize the high-resolution timer hardware.
+ *
+ * Starts the free-running counter and enables the compare interrupt of the
+ * hardware timer selected by __sHRTIMER_PORT. It runs independently of the
+ * SysTick rate.
+ *
+ * @param timerClockHz Input clock of the hardware timer in Hz (at least 1MHz).
+ *
+ * @retval sRTOS_OK Timer started.
+ * @retval sRTOS_ERROR The clock is below 1MHz.
+ *
+ * @note Requires __sUSE_HRTIMER to be set to 1.
+ */
+sRTOS_StatusTypeDef sRTOSHRTimerInit(sUBaseType_t timerClockHz);
+
+/**
+ * @brief Start a one-shot high-resolution timer.
+ *
+ * @param timerHandle Timer object (owned by the caller, zero-initialized before its
+ *                    first use and valid while armed).
+ * @param delay_us    Delay in microseconds, longer delays are clamped to 2^31 - 1 timer counts.
+ * @param callback    Function called from the hardware timer interrupt at expiry.
+ * @param arg         Argument passed to callback.
+ *
+ * @note Restarting an armed timer moves its expiry.
+ * @note The callback runs in ISR context, only FromISR APIs may be used.
+ */
+void sRTOSHRTimerStart(sHRTimer_t *timerHandle, sUBaseType_t delay_us, sHRTimerFunc_t callback, void *arg);
+
+/**
+ * @brief Cancel a high-resolution timer.
+ *
+ * @param timerHandle Timer to cancel; nothing happens if it is not armed.
+ */
+void sRTOSHRTimerCancel(sHRTimer_t *timerHandle);
+
+/**
+ * @return Microseconds counted by the high-resolution timer (wraps around at 2^32).
+ */
+sUBaseType_t sRTOSHRTimerNow(void);
 
 #endif /* SIMPLERTOS_H_ */
@@ -22,7 +22,67 @@
 #define __sQUANTA 2                     // the quanta duration is relative to __sRTOS_SENSIBILITY
                                         // if sensibility is 100us then 1 quanta = 100us
                                         //(note:same priority tasks are rotate)
-#define __sTIMER_TASK_STACK_DEPTH 256   // in words
+                                        // sRTOSTaskSetTimeSlice gives a task its own slice
+#define __sQUANTA_EXPIRED 0xFF          // set by a yield to end the slice of the current task (time slices must be below it)
+#define __sTIMER_TASK_STACK_DEPTH 256   // in words, one stack shared by every timer callback
+#define __sTIMER_MAX_SLACK 100          // in ticks, upper bound of the slack set by sRTOSTimerSetSlack
+
+#define __sUSE_TIMER_DAEMON 0                       // if set to 1 timer callbacks run in a daemon task instead of the SysTick exception
+                                                    // (SysTick only queues expired timers, callbacks may use blocking APIs)
+#define __sTIMER_DAEMON_PRIORITY sPriorityRealtime  // priority of the timer daemon task
+#define __sTIMER_DAEMON_STACK_DEPTH 256             // in words
+#define __sTIMER_QUEUE_LENGTH 16                    // expired timers waiting for the daemon (expirations are dropped if full, see droppedExpiries)
+#define __sUSE_DEFERRED_WORK 0                      // if set to 1 a task runs the work deferred by sRTOSDeferFromISR
+#define __sDEFERRED_WORK_PRIORITY sPriorityRealtime // priority of the deferred work task
+#define __sDEFERRED_WORK_STACK_DEPTH 256            // in words
+#define __sDEFERRED_QUEUE_LENGTH 32                 // pending deferred calls (must be a power of 2)
+
+#define __sUSE_COROUTINES 0                         // if set to 1 stackless coroutines (sRTOSCoroutineCreate) run on the stack of one kernel task
+#define __sCOROUTINE_STACK_DEPTH 256                // in words, shared by every coroutine
+
+#define __sUSE_BASIC_TASKS 0                        // if set to 1 run-to-completion basic tasks (sRTOSBasicTaskCreate) share one stack
+#define __sBASIC_TASK_STACK_DEPTH 512               // in words, deepest nesting of basic tasks (one frame per priority level)
+
+#define __sUSE_LATENCY_STATS 0                      // if set to 1 the scheduling latency of every task is recorded in log2 histograms
+#define __sLATENCY_CLOCK_DWT 1                      // DWT CYCCNT, counts core clock cycles (not available on ARMv6-M)
+#define __sLATENCY_CLOCK_CMSDK 2                    // CMSDK TIMER0 (QEMU mps2), free running, shared with the CMSDK high-resolution timers
+#define __sLATENCY_CLOCK __sLATENCY_CLOCK_DWT
+#define __sLATENCY_BUCKETS 20                       // bucket i counts the latencies of [2^i, 2^(i+1)) clock counts, the last one also counts everything above
+#define __sUSE_CRITICAL_STATS 0                     // if set to 1 every critical region records how long it masked the interrupts, and where (uses __sLATENCY_CLOCK)
+#define __sCRITICAL_STATS_TOP 8                     // call sites with the longest critical regions kept by sRTOSCriticalGetStats
+#define __sUSE_OBJECT_STATS 0                       // if set to 1 semaphores, mutexes and queues count their acquisitions, waits, timeouts and queue levels (sRTOSObjectGetStats)
+#define __sMAX_NAMED_OBJECTS 16                     // entries of the object registry filled by sRTOSObjectRegister
+
+#define __sUSE_PARTITIONS 0                         // if set to 1 tasks are grouped in partitions that only run in their time windows (sRTOSPartitionSetSchedule)
+#define __sPARTITION_COUNT 3                        // partitions, including the system partition 0 whose tasks can run in every window
+#define __sMAX_PARTITION_WINDOWS 8                  // windows in the major frame
+
+#define __sUSE_CPU_BUDGETS 0                        // if set to 1 a task can be limited to a CPU budget per period (sRTOSTaskSetBudget), charged by SysTick
+#define __sUSE_FAIR_SHARE 0                         // if set to 1 the tasks of __sFAIR_SHARE_PRIORITY share the CPU by weight (sRTOSTaskSetWeight) instead of in turn
+#define __sFAIR_SHARE_PRIORITY sPriorityLow         // priority level scheduled by virtual runtime, the other levels stay round-robin
+#define __sFAIR_SHARE_MAX_TASKS 16                  // ready tasks of that level ordered by virtual runtime (per partition), the level is round-robin while more are ready
+#define __sFAIR_SHARE_DEFAULT_WEIGHT 10             // weight of a task that has not called sRTOSTaskSetWeight (1 to 255)
+
+#define __sUSE_HRTIMER 0                // if set to 1 sub-tick one-shot timers are run from a hardware compare timer
+#define __sHRTIMER_PORT_CMSDK 1         // CMSDK APB timers (QEMU mps2): TIMER0 free running, TIMER1 as compare
+#define __sHRTIMER_PORT_STM32_TIM2 2    // STM32F4 TIM2: 32-bit counter prescaled to 1MHz, CCR1 as compare
+#define __sHRTIMER_PORT __sHRTIMER_PORT_STM32_TIM2
+#define __sHRTIMER_IRQn 28              // compare interrupt: 28 for TIM2, CMSDK TIMER1 is 9 on AN385 and 4 on AN505
+#define __sHRTIMER_WRAP_IRQn 8          // CMSDK TIMER0 interrupt counting the wraps of the time base: 8 on AN385, 3 on AN505 (unused by TIM2)
+
+#define __sTASK_NOTIFICATION_SLOTS 1    // notification slots per task (index 0 is used by sRTOSTaskNotify/sRTOSTaskNotifyTake)
+
+#define __sUSE_KERNEL_HEAP 1            // if set to 1 the kernel allocates from its own TLSF heap (O(1) allocation and free, with statistics)
+                                        // instead of the C library malloc/free
+#define __sKERNEL_HEAP_SIZE (16 * 1024) // in bytes, static region added to the kernel heap (0: only the regions given to sRTOSHeapAddRegion)
+
+#define __sUSE_STATIC_CONFIG 0          // if set to 1 the tasks, ready lists and kernel objects are generated at build time
+                                        // by tools/sRTOSgen.py (sRTOSStaticConfig.c), and sRTOSInit does not allocate the idle task
+
+#define __sMAX_SYSCALL_PRIORITY 0x50    // critical regions raise BASEPRI to this priority (value of the priority byte, lower is more urgent):
+                                        // interrupts with a lower value are never masked by the kernel and must not call it,
+                                        // SysTick and SVC run at 0xE0 (ARMv6-M has no BASEPRI, critical regions mask every interrupt)
+
 #define __sMAX_DELAY 0xFFFFFFFF
 
 #endif
@@ -10,9 +10,11 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include "simpleRTOSConfig.h"
 
 #define __STATIC_FORCEINLINE__ __attribute__((always_inline)) static __inline
 #define __STATIC_NAKED__ __attribute__((naked)) static
+#define __NAKED__ __attribute__((naked))
 
 #define srFALSE 0u
 #define srTRUE 1u
@@ -20,13 +22,19 @@
 #define CONTEXT_STACK_SIZE 8
 #define MIN_STACK_SIZE_NO_FPU 16
 #define MIN_STACK_SIZE_FPU 49
+#if defined(__ARM_ARCH_8M_MAIN__)
+#define STACK_LIMIT_GUARD_WORDS 24 // below PSPLIM: r4-r11 and s16-s31 saved by the context switch (CONTEXT_LIMIT_OFFSET)
+#else
+#define STACK_LIMIT_GUARD_WORDS 0
+#endif
 #define MAX_TASK_NAME_LEN 12
 #define MAX_TASK_PRIORITY_COUNT 32
 
-#define SAT_ADD_U32(a, b) (((UINT32_MAX - (uint32_t)(a)) < (uint32_t)(b)) ? UINT32_MAX : (uint32_t)((uint32_t)(a) + (uint32_t)(b)))
-
 typedef int32_t sBaseType_t;
 typedef uint32_t sUBaseType_t;
+typedef uint64_t sTick_t; // 64-bit tick count, does not wrap around in the lifetime of a device
+
+#define sTICK_MAX UINT64_MAX
 
 typedef enum
 {
@@ -61,6 +69,22 @@ enum
 
 typedef signed char sPriority_t;
 
+typedef enum
+{
+  sNotifyNoAction = 0,    // only signal the slot, the value is unchanged
+  sNotifySetBits,         // value |= message (event flags)
+  sNotifyIncrement,       // value++ (counting semaphore), message is ignored
+  sNotifyOverwrite,       // value = message
+  sNotifyOverwriteIfEmpty // value = message, only if the slot has no pending notification
+} sNotifyAction_t;
+
+typedef enum
+{
+  sNotificationEmpty = 0,
+  sNotificationPending, // a notification was sent and not taken yet
+  sNotificationWaiting  // the task is blocked in sRTOSTaskNotifyTakeIndexed on this slot
+} sNotificationState_t;
+
 typedef enum
 {
   sBlocked,
@@ -70,6 +94,40 @@ typedef enum
   sWaiting
 } sTaskStatus_t;
 
+typedef struct
+{
+  sUBaseType_t bucket[__sLATENCY_BUCKETS]; // bucket[i]: latencies of [2^i, 2^(i+1)) clock counts (bucket[0] also counts 0)
+  sUBaseType_t samples;
+  sUBaseType_t max; // worst case, in clock counts
+} sLatencyHistogram_t;
+
+typedef struct
+{
+  sLatencyHistogram_t wakeup;    // made ready by the kernel (timeout, resume, another task) until it runs
+  sLatencyHistogram_t isrToTask; // made ready by a peripheral interrupt (FromISR APIs) until it runs
+} sLatencyStats_t;
+
+typedef struct
+{
+  const char *file;   // call site of __sCriticalRegionBegin (NULL if the slot is empty)
+  sUBaseType_t line;
+  sUBaseType_t max;   // longest time the interrupts were masked from this call site, in clock counts
+  sUBaseType_t count; // critical regions measured from this call site since it entered the table
+} sCriticalSite_t;
+
+typedef struct
+{
+  sUBaseType_t regions;                       // outermost critical regions measured
+  sCriticalSite_t worst;                      // longest critical region
+  sCriticalSite_t top[__sCRITICAL_STATS_TOP]; // call sites with the longest critical regions, longest first
+} sCriticalStats_t;
+
+typedef enum
+{
+  sBudgetDemote,  // the task runs at sPriorityIdle until its budget is replenished
+  sBudgetSuspend, // the task is suspended until its budget is replenished
+} sBudgetPolicy_t;
+
 __attribute__((packed, aligned(4))) struct tcb
 {
   sUBaseType_t *stackPt;
@@ -80,41 +138,190 @@ __attribute__((packed, aligned(4))) struct tcb
   sbool_t regitersSaved; // tells the scheduler to save the registers if true
   sUBaseType_t *stackBase;
   struct tcb *prevTask;
-  sUBaseType_t notificationMessage;
-  sbool_t hasNotification;
+  sUBaseType_t notificationValue[__sTASK_NOTIFICATION_SLOTS];
+  sNotificationState_t notificationState[__sTASK_NOTIFICATION_SLOTS];
   sPriority_t originalPriority; // this save the original priority of the task before being change by mutex
   char name[12];
+  sPriority_t inheritedPriority; // priority inherited from tasks blocked on a lock held by this task (sPriorityMin if none)
+  sbool_t exclusiveWait;         // the task is blocked on a rwlock waiting for exclusive (write) access
+  sbool_t waitGranted;           // set by the task that releases a lock when it hands it to this task (or wakes it from a queue)
+  struct tcb *nextWaiter;        // next task blocked on the same object
+  struct tcb **waitList;         // wait list the task is blocked in (NULL if none), it is unlinked from it when deleted.
+                                 // a task woken from a queue keeps it until it runs, the wakeup is passed on if it is stopped or deleted first
+  volatile sUBaseType_t *waitCount; // waiter counter of that object, decremented with the unlink (NULL if none)
+  struct tcb *volatile *waitHolder; // owner of that lock, it drops the priority inherited from the task (NULL if none)
+  volatile sUBaseType_t heldLocks __attribute__((aligned(4))); // mutexes and write locks held, the inherited priority is dropped with the last one
+  sbool_t stopped;               // stopped by sRTOSTaskStop: a give or notify does not wake it, only sRTOSTaskResume does
+  sbool_t isStatic;              // the tcb and its stack are generated at build time and are never freed
+  sbool_t isBasic;               // run-to-completion task on the shared basic task stack (the tcb is the first member of a sBasicTask_t)
+  uint8_t timeSlice;             // round-robin slice in ticks (0: __sQUANTA)
+#if __sUSE_CPU_BUDGETS == 1
+  uint8_t budgetPolicy;          // sBudgetPolicy_t
+  sbool_t budgetThrottled;       // the budget is exhausted, the task is in the throttled list until the replenishment
+  sbool_t budgetSuspended;       // removed from the ready list by sBudgetSuspend, made ready at the replenishment
+  sUBaseType_t budget;           // ticks the task can run per period (0: no budget)
+  sUBaseType_t budgetLeft;       // ticks left in the current period
+  sUBaseType_t budgetPeriod;     // in ticks
+  sTick_t budgetReplenish;       // end of the current period
+  struct tcb *nextThrottled;     // next task of the throttled list
+#endif
+#if __sUSE_FAIR_SHARE == 1
+  uint8_t fairWeight;            // CPU share relative to the other tasks of __sFAIR_SHARE_PRIORITY (0: __sFAIR_SHARE_DEFAULT_WEIGHT)
+  uint8_t fairIndex;             // position + 1 in the virtual runtime heap (0: not in the heap)
+  sUBaseType_t vruntime;         // ticks run, scaled by the inverse of the weight (wraps around, compared by difference)
+#endif
+#if __sUSE_PARTITIONS == 1
+  uint8_t partition;             // time partition of the task (0: system partition, runs in every window)
+#endif
+#if __sUSE_LATENCY_STATS == 1
+  sbool_t latencyPending;        // readyStamp is set, the latency is recorded when the task is switched in
+  sbool_t latencyFromISR;        // the task was made ready by a peripheral interrupt
+  sUBaseType_t readyStamp;       // latency clock when the task became ready
+  sLatencyStats_t latency;
+#endif
 };
 
 typedef struct tcb sTaskHandle_t;
 
-typedef struct __attribute__((packed, aligned(4)))
+typedef struct
+{
+  sUBaseType_t partition;     // partition that runs during the window
+  sUBaseType_t durationTicks; // length of the window
+  sbool_t donateIdle;         // while the partition has no ready task, the other partitions may use the window
+} sPartitionWindow_t;
+
+typedef struct sBasicTask
+{
+  sTaskHandle_t tcb;            // must be the first member, the scheduler handles the basic task as a task
+  void (*func)(void *arg);      // called on every activation, returns when the work is done
+  void *arg;
+  sbool_t started;              // the task has a frame on the basic task stack
+  struct sBasicTask *preempted; // basic task whose frame is just above this one on the basic task stack
+} sBasicTask_t;
+
+typedef struct __attribute__((packed, aligned(4))) sTimer
 {
-  sUBaseType_t *stackPt;   // Pointer to the stack
-  sUBaseType_t *stackBase; // Pointer to the Base of the stack
+  sUBaseType_t *stackPt;   // Pointer to the callback frame on the shared timer stack
   sUBaseType_t id;         // Timer id
   sBaseType_t Period;      // Timer period in ticks (the period is relative to __sRTOS_SENSIBILITY)
   sbool_t autoReload;      // Timer autoReload
   sTaskStatus_t status;
+  void (*callback)(struct sTimer *timerHandle); // Timer callback
+  sUBaseType_t slack;      // Ticks the expiry may be delayed so it runs together with other timers
 } sTimerHandle_t;
 
+typedef struct
+{
+  sUBaseType_t expiryPasses;    // ticks on which expired timeouts were processed
+  sUBaseType_t mergedExpiries;  // timers run early to share another timer's expiry pass
+  sUBaseType_t droppedExpiries; // expirations lost because the timer daemon queue was full
+} sTimerStats_t;
+
 typedef void (*sTaskFunc_t)(void *arg);
 typedef void (*sTimerFunc_t)(sTimerHandle_t *timerHandle);
-typedef sBaseType_t sSemaphore_t;
+typedef void (*sDeferredFunc_t)(void *arg);
+typedef void (*sHRTimerFunc_t)(void *arg);
+
+typedef struct sCoroutine
+{
+  void (*func)(struct sCoroutine *co, void *arg); // body, runs from its last continuation point until it waits again
+  void *arg;
+  uint16_t resumePoint;            // continuation point (__LINE__ of the last wait), 0 before the first run
+  sTaskStatus_t status;            // sReady, sRunning, sWaiting (delay or timeout), sBlocked (notification) or sDeleted (finished)
+  sPriority_t priority;
+  sNotificationState_t notificationState;
+  sUBaseType_t notificationValue;
+  struct sCoroutine *next;         // next coroutine in the same ready list
+} sCoroutine_t;
+
+typedef void (*sCoroutineFunc_t)(sCoroutine_t *co, void *arg);
+
+typedef struct sHRTimer
+{
+  sHRTimerFunc_t callback;
+  void *arg;
+  sUBaseType_t expiry;   // hardware timer count at which the callback runs
+  sbool_t armed;
+  struct sHRTimer *next; // next armed timer, ordered by expiry
+} sHRTimer_t;
 typedef struct
 {
-  sSemaphore_t sem;
-  sTaskHandle_t *holderHandle;
-  sTaskHandle_t *requesterHandle;
+  sUBaseType_t totalBytes;           // bytes managed by the kernel heap (payloads)
+  sUBaseType_t freeBytes;            // bytes free now
+  sUBaseType_t minimumEverFreeBytes; // lowest freeBytes since boot (headroom)
+  sUBaseType_t largestFreeBlock;     // largest allocation that can succeed now
+  sUBaseType_t allocations;          // successful allocations
+  sUBaseType_t failedAllocations;    // allocations that found no fitting block
+  sUBaseType_t fragmentation;        // per mille of the free bytes outside the largest free block
+} sHeapStats_t;
+
+typedef enum
+{
+  sObjectSemaphore,
+  sObjectMutex,
+  sObjectQueue
+} sObjectType_t;
+
+typedef struct
+{
+  volatile sUBaseType_t acquisitions; // successful takes, or sends and receives for a queue
+  sUBaseType_t contended;             // calls that blocked because the object was not available
+  sUBaseType_t timeouts;              // blocked calls that gave up without the object
+  sTick_t totalWaitTicks;             // ticks spent blocked on the object, summed over every task
+  sTick_t maxWaitTicks;               // longest single wait
+  sUBaseType_t highWater;             // queue: most items ever stored at once
+  sUBaseType_t fullEvents;            // queue: sends that found it full
+  sUBaseType_t emptyEvents;           // queue: receives that found it empty
+} sObjectStats_t;
+
+typedef struct
+{
+  const char *name;
+  sObjectType_t type;
+  void *object;         // the sSemaphore_t, sMutex_t or sQueueHandle_t
+  sObjectStats_t stats; // copy taken by sRTOSObjectGetInfo
+} sObjectInfo_t;
+
+typedef struct
+{
+  volatile sBaseType_t count;     // available units, updated with LDREX/STREX when no task is waiting
+  volatile sUBaseType_t waiters;  // tasks blocked on the semaphore, the kernel is entered only when it is not 0
+  sTaskHandle_t *waitList;        // blocked tasks, in arrival order
+#if __sUSE_OBJECT_STATS == 1
+  sObjectStats_t stats;
+#endif
+} sSemaphore_t;
+
+typedef struct
+{
+  sTaskHandle_t *volatile holderHandle; // owner, NULL if free. Updated with LDREX/STREX when no task is waiting
+  volatile sUBaseType_t waiters;        // tasks blocked on the mutex
+  sTaskHandle_t *waitList;              // blocked tasks, in arrival order
+#if __sUSE_OBJECT_STATS == 1
+  sObjectStats_t stats;
+#endif
 } sMutex_t;
 
+typedef struct
+{
+  sBaseType_t readers;         // number of tasks holding the lock in shared (read) mode
+  sTaskHandle_t *writer;       // task holding the lock in exclusive (write) mode, NULL if none
+  sUBaseType_t waitingWriters; // writers blocked on the lock, new readers are held back while it is not 0
+  sTaskHandle_t *waitList;     // tasks blocked on the lock, in arrival order
+} sRwLock_t;
+
 typedef struct
 {
   sUBaseType_t maxLenght;
   sUBaseType_t lenght;
   sUBaseType_t itemSize;
-  sUBaseType_t index;
-  void **items;
+  sUBaseType_t readIndex;         // slot of the oldest item
+  uint8_t *storage;               // maxLenght * itemSize bytes, items are copied in place
+  sTaskHandle_t *sendWaitList;    // senders blocked while the queue is full, in arrival order
+  sTaskHandle_t *receiveWaitList; // receivers blocked while the queue is empty, in arrival order
+#if __sUSE_OBJECT_STATS == 1
+  sObjectStats_t stats;
+#endif
 } sQueueHandle_t;
 
 #endif /* SIMPLERTOSTYPES_H_ */
@@ -1,3 +1,5 @@
+// ARMv7-M (Cortex-M3/M4) context switch, ARMv6-M builds use simpleRTOSArmV6M.s, ARMv8-M Mainline builds simpleRTOSArmV8M.s
+#if !defined(__ARM_ARCH_6M__) && !defined(__ARM_ARCH_8M_MAIN__)
 .syntax unified
 .cpu cortex-m4
 .thumb
@@ -6,31 +8,58 @@
 .extern _sCurrentTask
 .extern _sRTOSGetFirstAvailableTask
 .extern _sCheckExpiredTimeOut
+.extern _sTaskTick
 .extern _sIsTimerRunning
 .extern _sTicksPassedExecutingCurrentTask
+.extern _sCriticalNesting
 .global SysTick_Handler
 .global SVC_Handler
+.global PendSV_Handler
 .global sScheduler_Handler
 .global sRTOSStartScheduler
 .global sTimerReturn_Handler
 
 #include "simpleRTOSConfig.h"
 
+// the handlers run only when no critical region is held (SysTick and SVC are masked by it):
+// they mask the interrupts that can call the kernel with BASEPRI and count as one critical region
+.macro sKernelLock
+    mov     r0, #__sMAX_SYSCALL_PRIORITY
+    msr     basepri, r0                 // interrupts above __sMAX_SYSCALL_PRIORITY stay enabled
+    isb
+    ldr     r0, =_sCriticalNesting
+    mov     r1, #1
+    str     r1, [r0]
+.endm
+
+.macro sKernelUnlock
+    ldr     r1, =_sCriticalNesting
+    mov     r2, #0
+    str     r2, [r1]
+    msr     basepri, r2
+.endm
+
 
 
 .section .text.SysTick_Handler,"ax",%progbits
 .type SysTick_Handler, %function
 SysTick_Handler:
-    cpsid   i                           // disable isr
+    sKernelLock
     ldr     r0, =_sTickCount
-    ldr     r1, [r0]                    // read _sTicksPassedExecutingCurrentTask
+    ldrd    r1, r2, [r0]                // read _sTickCount (r1 low word, r2 high word)
     adds    r1, #1
-    str     r1, [r0]                    // save _sTickCount++
+    adc     r2, r2, #0
+    strd    r1, r2, [r0]                // save _sTickCount++ (64-bit, sGetTick reads it without locking)
 
     ldr     r0, =_sTicksPassedExecutingCurrentTask
     ldr     r1, [r0]                    // read _sTicksPassedExecutingCurrentTask
     adds    r1, #1
     str     r1, [r0]                    // save _sTicksPassedExecutingCurrentTask++
+#if __sUSE_CPU_BUDGETS == 1 || __sUSE_FAIR_SHARE == 1
+    push    {lr}
+    bl      _sTaskTick                  // charge the tick to the current task (budget, virtual runtime)
+    pop     {lr}
+#endif
 
     ldr     r0, =_sIsTimerRunning       //
     ldr     r0, [r0]                    // read value of _sIsTimerRunning
@@ -40,14 +69,19 @@ Timer_return:
     push    {lr}
     bl      _sCheckExpiredTimeOut               // get timer available else return null (this also decrement the timers)
     pop     {lr}
+#if __sUSE_TIMER_DAEMON == 0
     cmp     r0, #0                      // check if NULL
     bne     sTimer_Handler              // running scheduler_Handler if a quantom has passed
+#endif
 #if __sUSE_PREEMPTION == 1
     b       sScheduler_Handler
 #else
-    cpsie   i
+    sKernelUnlock
     bx      lr
 #endif
+2:
+    sKernelUnlock
+    bx      lr
 .size SysTick_Handler, .-SysTick_Handler
 
 
@@ -55,7 +89,7 @@ Timer_return:
 .section .text.SVC_Handler,"ax",%progbits
 .type SVC_Handler, %function
 SVC_Handler:
-    cpsid   i                           // disable isr
+    sKernelLock
     TST lr, #4                   
     ITE EQ                       
     MRSEQ r0, MSP                
@@ -68,19 +102,36 @@ SVC_Handler:
     beq     sScheduler_Handler_andRest   
     cmp     r1, #1               
     beq     sTimerReturn_Handler        // timer Return
-    cpsie   i                    
+    sKernelUnlock
     bx      lr                  
 
 sScheduler_Handler_andRest:
 #if __sUSE_PREEMPTION == 1
     ldr     r1, =_sTicksPassedExecutingCurrentTask
-    mov	    r2, #__sQUANTA
+    mov	    r2, #__sQUANTA_EXPIRED
     str     r2, [r1]                    // rest _sTicksPassedExecutingCurrentTask
 #endif
     b       sScheduler_Handler
 .size SVC_Handler, .-SVC_Handler
 
 
+.section .text.PendSV_Handler,"ax",%progbits
+.type PendSV_Handler, %function
+PendSV_Handler:                         // pended by sRTOSYieldFromISR, runs once the last interrupt has returned
+    sKernelLock
+    tst     lr, #4
+    beq     1f                          // main runs on MSP: the scheduler has not started
+    ldr     r0, =_sIsTimerRunning
+    ldr     r0, [r0]
+    cmp     r0, #1
+    beq     1f                          // a timer callback runs, the scheduler runs when it returns
+    b       sScheduler_Handler          // switches only if a higher priority task is ready
+1:
+    sKernelUnlock
+    bx      lr
+.size PendSV_Handler, .-PendSV_Handler
+
+
 
 /*
     
@@ -108,47 +159,46 @@ This ensures the interrupted code resumes correctly after the interrupt.
 .type sTaskSaveRegisters, %function      
 sTaskSaveRegisters:
 // argument r0: is TaskHandle for the task you want to save it registers
-// note: r1 is changed in this routine
-// use register to save the lr before jumping to this routine because the satck will change
+// note: r1 and r12 are changed in this routine
+// the registers are saved on the task stack (PSP), the handler stack (MSP) is not touched
     ldrb    r1, [r0, #11]               // read current regitersSaved
     cmp     r1, #1                      // check if the task has saved regiters
-    beq     1f
-    push    {r4-r7}                     // save r4,r5,r6,r7,
-    stmdb   sp!, {r8-r11}               //      r8,r9,r10,r11
-    ldrb	r1, [r0, #8]                // Task->fps
-    cmp     r1, #1                      // check if floating point stage is on
+    beq     2f
+    mrs     r1, psp                     // task sp, the hardware frame is already on it
+    stmdb   r1!, {r4-r7}                // save r4,r5,r6,r7,
+    stmdb   r1!, {r8-r11}               //      r8,r9,r10,r11
+    ldrb    r12, [r0, #8]               // Task->fps
+    cmp     r12, #1                     // check if floating point stage is on
     bne     1f                          //
-    vstmdb  sp!, {s0-s31}               // if float point mode is on save fpu registers of the current task
-    vmrs    r1, fpscr                   //
-    push    {r1}                        //
+    vstmdb  r1!, {s0-s31}               // if float point mode is on save fpu registers of the current task
+    vmrs    r12, fpscr                  //
+    str     r12, [r1, #-4]!             //
 1:
+    str     r1, [r0]                    // save the new current task sp
+2:
     mov     r1, #1
-    strb	r1, [r0, #11]               // change RegitersSaved to true
-    str     sp, [r0]                    // save the new current task sp
+    strb    r1, [r0, #11]               // change RegitersSaved to true
     bx      lr
 .size sTaskSaveRegisters, .-sTaskSaveRegisters
 
 .section .text.sTaskRestoreRegisters,"ax",%progbits
 .type sTaskRestoreRegisters, %function
 sTaskRestoreRegisters:
-// argument r0: is TaskHandle for the task you want to save it registers
-// note: r1 is changed in this routine
-// use register to save the lr before jumping to this routine because the satck will change
-    ldr     sp, [r0]                    // set task sp
-    ldrb    r1, [r0, #11]               // read current regitersSaved
-    cmp     r1, #1                      // check if the task has saved regiters
-    bne     1f
-    ldrb    r1, [r0, #8]                // Task->fps
-    cmp     r1, #1                      //
+// argument r0: is TaskHandle for the task you want to restore it registers
+// note: r1 and r12 are changed in this routine
+    ldr     r1, [r0]                    // task sp
+    ldrb    r12, [r0, #8]               // Task->fps
+    cmp     r12, #1                     //
     bne     1f                          //
-    pop     {r1}                        // if float point mode is on restore fpu registers of the next task
-    vmsr    fpscr, r1                   //
-    vldmia  sp!, {s0-s31}               //
+    ldr     r12, [r1], #4               // if float point mode is on restore fpu registers of the next task
+    vmsr    fpscr, r12                  //
+    vldmia  r1!, {s0-s31}               //
 1:
-    ldmia   sp!, {r8-r11}               //
-    pop     {r4-r7}                     //
+    ldmia   r1!, {r8-r11}               //
+    ldmia   r1!, {r4-r7}                //
+    msr     psp, r1                     // the hardware frame is popped from PSP on exception return
     mov     r1, #0
-    strb	r1, [r0, #11]               // change RegitersSaved to false
+    strb    r1, [r0, #11]               // change RegitersSaved to false
     bx      lr
 .size sTaskRestoreRegisters, .-sTaskRestoreRegisters
 
@@ -183,7 +233,7 @@ sScheduler_Handler:                     // r0,r1,r2,r3,r12,lr,pc,psr   saved by
     ldr     r1, =_sCurrentTask
     str     r0, [r1]                    // change the current running task ptr
 2:
-    cpsie   i                           // enable isr  
+    sKernelUnlock
     bx      lr                          // return and start the next task
 .size sScheduler_Handler, .-sScheduler_Handler
 
@@ -203,18 +253,20 @@ as if nothing happened.
    - If the interrupt handler or RTOS saved more registers (like `r4`–`r11`),
    it must restore them before returning.
 
-3. **Returning with `bx lr` and `lr = 0xFFFFFFF9`:**  
+3. **Returning with `bx lr` and `lr = 0xFFFFFFFD`:**  
    - In ARM Cortex-M, the **link register (`lr`)** is set to a special value called
-   **EXC_RETURN** (e.g., `0xFFFFFFF9`) during an exception.
-   - Executing `bx lr` with `lr = 0xFFFFFFF9` tells the processor:
+   **EXC_RETURN** (e.g., `0xFFFFFFFD`) during an exception.
+   - Executing `bx lr` with `lr = 0xFFFFFFFD` tells the processor:
      - "I am done with the interrupt. Restore the context from the
-     stack and resume execution in Thread mode using the Main Stack Pointer (MSP)."
+     stack and resume execution in Thread mode using the Process Stack Pointer (PSP)."
    - The processor automatically pops the saved hardware registers and resumes the interrupted code.
+   - Tasks run on PSP and the exception handlers on MSP, so the handlers only have to
+     change PSP to switch to another task, their own stack is never moved.
 
 ---
 
 **Summary:**  
-- `bx lr` with `lr = 0xFFFFFFF9` triggers the ARM Cortex-M exception return mechanism.
+- `bx lr` with `lr = 0xFFFFFFFD` triggers the ARM Cortex-M exception return mechanism.
 - The processor restores all hardware-saved registers and resumes execution where the
     interrupt occurred.
 
@@ -236,8 +288,9 @@ sTimer_Handler:                         // r0,r1,r2,r3,r12,lr,pc,psr   saved by
     mov     lr, r3
 
     mov     r0, r2                      // restore the the timerHandle to r0, because it the argument to the for the timer
-    ldr     sp, [r0]                    // SP = Timer Task
-    cpsie   i                           // isr is enabled
+    ldr     r1, [r0]
+    msr     psp, r1                     // PSP = Timer Task
+    sKernelUnlock
     bx      lr                          // return and start the next task
 .size sTimer_Handler, .-sTimer_Handler
 
@@ -245,8 +298,7 @@ sTimer_Handler:                         // r0,r1,r2,r3,r12,lr,pc,psr   saved by
 
 .section .text.sTimerReturn_Handler,"ax",%progbits
 .type sTimerReturn_Handler, %function
-sTimerReturn_Handler:
-    cpsid   i                           // disable isr
+sTimerReturn_Handler:                   // entered from SVC_Handler, the kernel is already locked
     ldr     r0, =_sCurrentTask          // the _sCurrentTask return the current task (r0 is the return value)
     ldr     r0, [r0]
     mov     r3, lr
@@ -260,33 +312,38 @@ sTimerReturn_Handler:
 .type sRTOSStartScheduler, %function
 sRTOSStartScheduler:
     cpsid   i                                   // disable isr
-    push    {lr}                                // save return address
-    bl	    _sRTOSGetFirstAvailableTask         // returns the first highest ready task
-    pop     {lr}                                // restore return address
-    ldr     sp, [r0]                            // switch to to the sp of the task
-    ldrb    r1, [r0, #8]                        // r2=task->fps
-/*
-    arm cmp r0 to true
-    if true: add sp, sp, #166
-    else: add sp, sp, #36
-*/
-    cmp     r1, #1                              // check if task->fps is on
+    bl      _sRTOSGetFirstAvailableTask         // returns the first highest ready task (main is never returned to)
+    ldr     r1, [r0]                            // task sp
+    ldrb    r2, [r0, #8]                        // r2=task->fps
+    cmp     r2, #1                              // check if task->fps is on
     ite     eq
-    addeq   sp, sp, #166                        // #166 represent the number of bytes used to restore the register if floating point mode is on
-    addne   sp, sp, #32                         // #31 epresent the number of bytes used to restore the register if floating point mode is off
-    add     sp, sp, #24 
-    pop     {r1}                                // pop the address of the task to execute
-    mov     lr, r1                              // setting the return address to the address of the task so when `sRTOSStartScheduler` finishs it return to the address of the task instad of `main`
-    ldr	    r1, =0x1                            // sRunning:0x1
-    strb	r1, [r0, #9]                        // change task status to sRunning
+    addeq   r1, r1, #164                        // fpscr, s0-s31, r8-r11, r4-r7
+    addne   r1, r1, #32                         // r8-r11, r4-r7 (a new task starts with them at 0)
+    ldr     lr, [r1, #20]                       // lr of the frame: _taskReturn
+    ldr     r12, [r1, #24]                      // pc of the frame: the task
+    ldr     r3, [r1]                            // r0 of the frame: the task argument
+    add     r1, r1, #32                         // the whole frame is popped
+    msr     psp, r1
+    mov     r1, #2                              // CONTROL.SPSEL: thread mode uses PSP
+    msr     control, r1
+    isb
+    ldr     r1, =0xE000ED08                     // VTOR
+    ldr     r1, [r1]
+    ldr     r1, [r1]                            // initial MSP from the vector table
+    msr     msp, r1                             // the stack of main is given back to the exception handlers
+    ldr     r1, =0x1                            // sRunning:0x1
+    strb    r1, [r0, #9]                        // change task status to sRunning
     ldr     r2, =_sCurrentTask                  // get the address of _sCurrentTask
     str     r0, [r2]                            // save the current task ptr
     mov     r1, #0
-    strb	r1, [r0, #11]                       // change regitersSaved to false (because registers are restored)
+    strb    r1, [r0, #11]                       // change regitersSaved to false (because registers are restored)
+    mov     r0, r3
     // ...enable SysTick...
-    ldr r0, =0xE000E010                         // #define SYST_CSR (*((volatile uint32_t *)0xE000E010))
-    movs r1, #7                                 // ENABLE | TICKINT | CLKSOURCE
-    str r1, [r0]                                // enable SysTick, enable exception, select processor clock
+    ldr     r1, =0xE000E010                     // #define SYST_CSR (*((volatile uint32_t *)0xE000E010))
+    movs    r2, #7                              // ENABLE | TICKINT | CLKSOURCE
+    str     r2, [r1]                            // enable SysTick, enable exception, select processor clock
     cpsie   i                                   // enable irq
-    bx      lr                                  // return
+    bx      r12                                 // start the task
 .size sRTOSStartScheduler, .-sRTOSStartScheduler
+
+#endif
@@ -0,0 +1,314 @@
+// ARMv6-M (Cortex-M0/M0+) context switch, ARMv7-M builds use simpleRTOS.s
+#if defined(__ARM_ARCH_6M__)
+.syntax unified
+.cpu cortex-m0plus
+.thumb
+
+.extern _sTickCount
+.extern _sCurrentTask
+.extern _sRTOSGetFirstAvailableTask
+.extern _sCheckExpiredTimeOut
+.extern _sTaskTick
+.extern _sIsTimerRunning
+.extern _sTicksPassedExecutingCurrentTask
+.extern _sCriticalNesting
+.global SysTick_Handler
+.global SVC_Handler
+.global PendSV_Handler
+.global sScheduler_Handler
+.global sRTOSStartScheduler
+.global sTimerReturn_Handler
+
+#include "simpleRTOSConfig.h"
+
+// the handlers run only when no critical region is held (SysTick and SVC are masked by it),
+// they count as one critical region (ARMv6-M has no BASEPRI, every interrupt is masked)
+.macro sKernelLock
+    cpsid   i
+    ldr     r0, =_sCriticalNesting
+    movs    r1, #1
+    str     r1, [r0]
+.endm
+
+.macro sKernelUnlock
+    ldr     r1, =_sCriticalNesting
+    movs    r2, #0
+    str     r2, [r1]
+    cpsie   i
+.endm
+
+/*
+Thumb-1 restrictions compared to simpleRTOS.s:
+   - stm/ldm only take r0-r7 and only increment: r8-r11 are moved through r4-r7 once those
+     are saved, the frame is written upwards from the new PSP, and lr is popped through r1.
+   - no IT blocks, no ldrd/strd, no conditional branch farther than 256 bytes:
+     every routine is kept in the same section and long conditional branches jump over a `b`.
+   - no FPU, task->fps is ignored.
+
+The frame saved on the task stack is the same as on ARMv7-M (r8-r11 at the lowest address,
+then r4-r7, then the hardware frame), so _taskInitStack and tools/sRTOSgen.py are unchanged.
+
+Cycles on Cortex-M0+ (zero wait state memory, taken branch 2 cycles, ldr/str 2, ldm/stm/push/pop 1+N):
+   sTaskSaveRegisters      about 32
+   sTaskRestoreRegisters   about 26
+   sScheduler_Handler      about 50 + _sRTOSGetFirstAvailableTask (about 40 with the de Bruijn lookup)
+   SysTick_Handler         about 25 + _sCheckExpiredTimeOut, then sScheduler_Handler
+Add the 15 cycles of exception entry and the 13 cycles of exception return (16/16 on Cortex-M0).
+*/
+
+.section .text.sRTOSArmV6M,"ax",%progbits
+
+.type SysTick_Handler, %function
+SysTick_Handler:
+    sKernelLock
+    ldr     r0, =_sTickCount
+    ldr     r1, [r0]                    // low word
+    ldr     r2, [r0, #4]                // high word
+    movs    r3, #0
+    adds    r1, #1
+    adcs    r2, r3
+    str     r1, [r0]
+    str     r2, [r0, #4]                // save _sTickCount++ (64-bit, sGetTick reads it without locking)
+
+    ldr     r0, =_sTicksPassedExecutingCurrentTask
+    ldr     r1, [r0]                    // read _sTicksPassedExecutingCurrentTask
+    adds    r1, #1
+    str     r1, [r0]                    // save _sTicksPassedExecutingCurrentTask++
+#if __sUSE_CPU_BUDGETS == 1 || __sUSE_FAIR_SHARE == 1
+    push    {lr}
+    bl      _sTaskTick                  // charge the tick to the current task (budget, virtual runtime)
+    pop     {r1}
+    mov     lr, r1
+#endif
+
+    ldr     r0, =_sIsTimerRunning
+    ldr     r0, [r0]                    // read value of _sIsTimerRunning
+    cmp     r0, #1
+    bne     Timer_return
+    sKernelUnlock                       // a timer is running, it finishes first
+    bx      lr
+Timer_return:
+    push    {lr}
+    bl      _sCheckExpiredTimeOut       // get timer available else return null (this also decrement the timers)
+    pop     {r1}
+    mov     lr, r1
+#if __sUSE_TIMER_DAEMON == 0
+    cmp     r0, #0                      // check if NULL
+    beq     1f
+    b       sTimer_Handler
+1:
+#endif
+#if __sUSE_PREEMPTION == 1
+    b       sScheduler_Handler
+#else
+    sKernelUnlock
+    bx      lr
+#endif
+.size SysTick_Handler, .-SysTick_Handler
+.ltorg
+
+
+
+.type SVC_Handler, %function
+SVC_Handler:
+    sKernelLock
+    movs    r0, #4
+    mov     r1, lr
+    tst     r0, r1                      // EXC_RETURN bit 2: which stack holds the frame
+    beq     1f
+    mrs     r0, psp
+    b       2f
+1:
+    mrs     r0, msp
+2:
+    ldr     r1, [r0, #24]               // uint8_t *pc = (uint8_t *)sp[6]; // stacked PC
+    subs    r1, #2
+    ldrb    r1, [r1]                    // uint8_t svc_number = pc[-2];
+    cmp     r1, #0                      // yeid
+    beq     sScheduler_Handler_andRest
+    cmp     r1, #1
+    bne     3f
+    b       sTimerReturn_Handler        // timer Return
+3:
+    sKernelUnlock
+    bx      lr
+
+sScheduler_Handler_andRest:
+#if __sUSE_PREEMPTION == 1
+    ldr     r1, =_sTicksPassedExecutingCurrentTask
+    movs    r2, #__sQUANTA_EXPIRED
+    str     r2, [r1]                    // rest _sTicksPassedExecutingCurrentTask
+#endif
+    b       sScheduler_Handler
+.size SVC_Handler, .-SVC_Handler
+.ltorg
+
+
+
+.type PendSV_Handler, %function
+PendSV_Handler:                         // pended by sRTOSYieldFromISR, runs once the last interrupt has returned
+    sKernelLock
+    movs    r0, #4
+    mov     r1, lr
+    tst     r0, r1
+    beq     1f                          // main runs on MSP: the scheduler has not started
+    ldr     r0, =_sIsTimerRunning
+    ldr     r0, [r0]
+    cmp     r0, #1
+    beq     1f                          // a timer callback runs, the scheduler runs when it returns
+    b       sScheduler_Handler          // switches only if a higher priority task is ready
+1:
+    sKernelUnlock
+    bx      lr
+.size PendSV_Handler, .-PendSV_Handler
+.ltorg
+
+
+
+.type sTaskSaveRegisters, %function
+sTaskSaveRegisters:
+// argument r0: is TaskHandle for the task you want to save it registers
+// note: r1 is changed in this routine, r4-r7 hold r8-r11 when it returns
+// the registers are saved on the task stack (PSP), the handler stack (MSP) is not touched
+    ldrb    r1, [r0, #11]               // read current regitersSaved
+    cmp     r1, #1                      // check if the task has saved regiters
+    beq     1f
+    mrs     r1, psp                     // task sp, the hardware frame is already on it
+    subs    r1, #32
+    str     r1, [r0]                    // save the new current task sp
+    adds    r1, #16
+    stmia   r1!, {r4-r7}                // save r4,r5,r6,r7 above
+    mov     r4, r8
+    mov     r5, r9
+    mov     r6, r10
+    mov     r7, r11
+    ldr     r1, [r0]
+    stmia   r1!, {r4-r7}                // r8,r9,r10,r11 at the lowest address
+1:
+    movs    r1, #1
+    strb    r1, [r0, #11]               // change RegitersSaved to true
+    bx      lr
+.size sTaskSaveRegisters, .-sTaskSaveRegisters
+
+.type sTaskRestoreRegisters, %function
+sTaskRestoreRegisters:
+// argument r0: is TaskHandle for the task you want to restore it registers
+// note: r1 is changed in this routine
+    ldr     r1, [r0]                    // task sp
+    ldmia   r1!, {r4-r7}                // r8,r9,r10,r11
+    mov     r8, r4
+    mov     r9, r5
+    mov     r10, r6
+    mov     r11, r7
+    ldmia   r1!, {r4-r7}                // r4,r5,r6,r7
+    msr     psp, r1                     // the hardware frame is popped from PSP on exception return
+    movs    r1, #0
+    strb    r1, [r0, #11]               // change RegitersSaved to false
+    bx      lr
+.size sTaskRestoreRegisters, .-sTaskRestoreRegisters
+
+
+
+.type sScheduler_Handler, %function
+sScheduler_Handler:                     // r0,r1,r2,r3,r12,lr,pc,psr   saved by interrupt
+    push    {lr}                        // save return address
+    bl      _sRTOSGetFirstAvailableTask // returns the first highest ready task
+    pop     {r1}
+    mov     lr, r1                      // restore return address
+    cmp     r0, #0                      // if AvailableTask is null then keep executing current task
+    beq     2f
+    mov     r2, r0
+    ldr     r0, =_sCurrentTask
+    ldr     r0, [r0]                    // load the addres of current task
+    mov     r3, lr
+    bl      sTaskSaveRegisters
+    mov     lr, r3
+    ldrb    r3, [r0, #9]                // read current status
+    cmp     r3, #1                      // check if the task status is running (the status cloud change by a timer if so the register are saved)
+    bne     1f
+    movs    r3, #2                      // sReady:0x02
+    strb    r3, [r0, #9]                // change current task status to sReady
+1:
+    mov     r0, r2                      // copy firstAvailableTask addr into r0
+    mov     r3, lr
+    bl      sTaskRestoreRegisters
+    mov     lr, r3
+    movs    r1, #1                      // sRunning:0x1
+    strb    r1, [r0, #9]                // change next task status to sRunning
+
+    ldr     r1, =_sCurrentTask
+    str     r0, [r1]                    // change the current running task ptr
+2:
+    sKernelUnlock
+    bx      lr                          // return and start the next task
+.size sScheduler_Handler, .-sScheduler_Handler
+.ltorg
+
+
+
+.type sTimer_Handler, %function
+sTimer_Handler:                         // r0,r1,r2,r3,r12,lr,pc,psr   saved by interrupt
+    ldr     r2, =_sIsTimerRunning
+    movs    r1, #1
+    str     r1, [r2]                    // change the _sIsTimerRunning to true
+    mov     r2, r0                      // save a copy of r0 which is the the timerHandle
+    ldr     r0, =_sCurrentTask
+    ldr     r0, [r0]
+
+    mov     r3, lr
+    bl      sTaskSaveRegisters
+    mov     lr, r3
+
+    mov     r0, r2                      // restore the the timerHandle to r0, because it the argument to the for the timer
+    ldr     r1, [r0]
+    msr     psp, r1                     // PSP = Timer Task
+    sKernelUnlock
+    bx      lr                          // return and start the timer callback
+.size sTimer_Handler, .-sTimer_Handler
+
+.type sTimerReturn_Handler, %function
+sTimerReturn_Handler:                   // entered from SVC_Handler, the kernel is already locked
+    ldr     r0, =_sCurrentTask
+    ldr     r0, [r0]
+    mov     r3, lr
+    bl      sTaskRestoreRegisters
+    mov     lr, r3
+    b       Timer_return                // rerun the scheduler in case the timer run at the end of quantum (which mean that the next task should run)
+.size sTimerReturn_Handler, .-sTimerReturn_Handler
+.ltorg
+
+
+
+.type sRTOSStartScheduler, %function
+sRTOSStartScheduler:
+    cpsid   i                           // disable isr
+    bl      _sRTOSGetFirstAvailableTask // returns the first highest ready task (main is never returned to)
+    ldr     r2, =_sCurrentTask
+    str     r0, [r2]                    // save the current task ptr
+    movs    r1, #1                      // sRunning:0x1
+    strb    r1, [r0, #9]
+    movs    r1, #0
+    strb    r1, [r0, #11]               // change regitersSaved to false (the frame is consumed here)
+
+    ldr     r1, [r0]
+    adds    r1, #32                     // skip r8-r11, r4-r7 (a new task starts with them at 0)
+    ldr     r2, [r1, #20]
+    mov     lr, r2                      // the task returns to _taskReturn
+    ldr     r4, [r1, #24]               // pc of the frame: the task
+    ldr     r0, [r1]                    // r0 of the frame: the task argument
+    adds    r1, #32                     // the whole frame is popped
+    msr     psp, r1
+    movs    r1, #2                      // CONTROL.SPSEL: thread mode uses PSP, the exception handlers keep MSP
+                                        // where main left it (Cortex-M0 has no VTOR to read the initial MSP from)
+    msr     control, r1
+    isb
+
+    ldr     r6, =0xE000E010             // #define SYST_CSR (*((volatile uint32_t *)0xE000E010))
+    movs    r7, #7                      // ENABLE | TICKINT | CLKSOURCE
+    str     r7, [r6]                    // enable SysTick, enable exception, select processor clock
+    cpsie   i                           // enable irq
+    bx      r4                          // start the task
+.size sRTOSStartScheduler, .-sRTOSStartScheduler
+.ltorg
+
+#endif
@@ -0,0 +1,319 @@
+// ARMv8-M Mainline (Cortex-M33) context switch, ARMv7-M builds use simpleRTOS.s
+#if defined(__ARM_ARCH_8M_MAIN__)
+.syntax unified
+.cpu cortex-m33
+.fpu fpv5-sp-d16
+.thumb
+
+.extern _sTickCount
+.extern _sCurrentTask
+.extern _sRTOSGetFirstAvailableTask
+.extern _sCheckExpiredTimeOut
+.extern _sTaskTick
+.extern _sIsTimerRunning
+.extern _sTicksPassedExecutingCurrentTask
+.extern _sCriticalNesting
+.global SysTick_Handler
+.global SVC_Handler
+.global PendSV_Handler
+.global sScheduler_Handler
+.global sRTOSStartScheduler
+.global sTimerReturn_Handler
+
+#include "simpleRTOSConfig.h"
+
+// the handlers run only when no critical region is held (SysTick and SVC are masked by it):
+// they mask the interrupts that can call the kernel with BASEPRI and count as one critical region
+.macro sKernelLock
+    mov     r0, #__sMAX_SYSCALL_PRIORITY
+    msr     basepri, r0                 // interrupts above __sMAX_SYSCALL_PRIORITY stay enabled
+    isb
+    ldr     r0, =_sCriticalNesting
+    mov     r1, #1
+    str     r1, [r0]
+.endm
+
+.macro sKernelUnlock
+    ldr     r1, =_sCriticalNesting
+    mov     r2, #0
+    str     r2, [r1]
+    msr     basepri, r2
+.endm
+
+/*
+Differences with simpleRTOS.s:
+
+1. **Stack limit:**
+   PSPLIM is loaded with task->stackBase on every switch (and with the shared timer stack
+   while a timer callback runs), so any push of the task below the limit raises a UsageFault
+   (CFSR.STKOF) before memory is corrupted, and the check costs nothing at run time.
+   The registers saved by software are written through a general register, which the hardware
+   does not check: the limit is set above the base by the size of that frame (CONTEXT_LIMIT_OFFSET),
+   and every task stack is allocated with that many extra words (STACK_LIMIT_GUARD_WORDS).
+   MSPLIM (the exception handlers) is left to the application, it knows where its main stack ends.
+
+2. **FPU state:**
+   The hardware stacks s0-s15 and fpscr (lazily) when the interrupted task used the FPU,
+   EXC_RETURN.FType (bit 4) is then 0. Only in that case s16-s31 are saved by software,
+   and task->fps records it, so the restore can rebuild the EXC_RETURN of the task.
+   The first frame of every task is a basic frame (task->fps starts at sFalse).
+
+sTaskSaveRegisters and sTaskRestoreRegisters take the EXC_RETURN value in r3.
+*/
+
+#define CONTEXT_LIMIT_OFFSET 96         // r4-r11 and s16-s31, 4 * STACK_LIMIT_GUARD_WORDS
+
+
+
+.section .text.SysTick_Handler,"ax",%progbits
+.type SysTick_Handler, %function
+SysTick_Handler:
+    sKernelLock
+    ldr     r0, =_sTickCount
+    ldrd    r1, r2, [r0]                // read _sTickCount (r1 low word, r2 high word)
+    adds    r1, #1
+    adc     r2, r2, #0
+    strd    r1, r2, [r0]                // save _sTickCount++ (64-bit, sGetTick reads it without locking)
+
+    ldr     r0, =_sTicksPassedExecutingCurrentTask
+    ldr     r1, [r0]                    // read _sTicksPassedExecutingCurrentTask
+    adds    r1, #1
+    str     r1, [r0]                    // save _sTicksPassedExecutingCurrentTask++
+#if __sUSE_CPU_BUDGETS == 1 || __sUSE_FAIR_SHARE == 1
+    push    {lr}
+    bl      _sTaskTick                  // charge the tick to the current task (budget, virtual runtime)
+    pop     {lr}
+#endif
+
+    ldr     r0, =_sIsTimerRunning       //
+    ldr     r0, [r0]                    // read value of _sIsTimerRunning
+    cmp     r0, #1
+    beq     2f                          // if a timer if running
+Timer_return:
+    push    {lr}
+    bl      _sCheckExpiredTimeOut       // get timer available else return null (this also decrement the timers)
+    pop     {lr}
+#if __sUSE_TIMER_DAEMON == 0
+    cmp     r0, #0                      // check if NULL
+    bne     sTimer_Handler              // running scheduler_Handler if a quantom has passed
+#endif
+#if __sUSE_PREEMPTION == 1
+    b       sScheduler_Handler
+#else
+    sKernelUnlock
+    bx      lr
+#endif
+2:
+    sKernelUnlock
+    bx      lr
+.size SysTick_Handler, .-SysTick_Handler
+
+
+
+.section .text.SVC_Handler,"ax",%progbits
+.type SVC_Handler, %function
+SVC_Handler:
+    sKernelLock
+    tst     lr, #4
+    ite     eq
+    mrseq   r0, msp
+    mrsne   r0, psp
+    ldr     r1, [r0, #24]               // uint8_t *pc = (uint8_t *)sp[6]; // stacked PC
+    ldrb    r1, [r1, #-2]               // uint8_t svc_number = pc[-2];
+    cmp     r1, #0                      // yeid
+    beq     sScheduler_Handler_andRest
+    cmp     r1, #1
+    beq     sTimerReturn_Handler        // timer Return
+    sKernelUnlock
+    bx      lr
+
+sScheduler_Handler_andRest:
+#if __sUSE_PREEMPTION == 1
+    ldr     r1, =_sTicksPassedExecutingCurrentTask
+    mov     r2, #__sQUANTA_EXPIRED
+    str     r2, [r1]                    // rest _sTicksPassedExecutingCurrentTask
+#endif
+    b       sScheduler_Handler
+.size SVC_Handler, .-SVC_Handler
+
+
+.section .text.PendSV_Handler,"ax",%progbits
+.type PendSV_Handler, %function
+PendSV_Handler:                         // pended by sRTOSYieldFromISR, runs once the last interrupt has returned
+    sKernelLock
+    tst     lr, #4
+    beq     1f                          // main runs on MSP: the scheduler has not started
+    ldr     r0, =_sIsTimerRunning
+    ldr     r0, [r0]
+    cmp     r0, #1
+    beq     1f                          // a timer callback runs, the scheduler runs when it returns
+    b       sScheduler_Handler          // switches only if a higher priority task is ready
+1:
+    sKernelUnlock
+    bx      lr
+.size PendSV_Handler, .-PendSV_Handler
+
+
+
+.section .text.sTaskSaveRegisters,"ax",%progbits
+.type sTaskSaveRegisters, %function
+sTaskSaveRegisters:
+// argument r0: is TaskHandle for the task you want to save it registers
+// argument r3: EXC_RETURN of the exception that interrupted the task
+// note: r1 and r12 are changed in this routine
+    ldrb    r1, [r0, #11]               // read current regitersSaved
+    cmp     r1, #1                      // check if the task has saved regiters
+    beq     2f
+    mrs     r1, psp                     // task sp, the hardware frame is already on it
+    stmdb   r1!, {r4-r7}                // save r4,r5,r6,r7,
+    stmdb   r1!, {r8-r11}               //      r8,r9,r10,r11
+    mov     r12, #0
+    tst     r3, #0x10                   // EXC_RETURN.FType: 0 if the hardware stacked an extended (FPU) frame
+    bne     1f
+    vstmdb  r1!, {s16-s31}              // the hardware saved s0-s15 and fpscr, save the rest
+    mov     r12, #1
+1:
+    strb    r12, [r0, #8]               // task->fps = extended frame saved
+    str     r1, [r0]                    // save the new current task sp
+2:
+    mov     r1, #1
+    strb    r1, [r0, #11]               // change RegitersSaved to true
+    bx      lr
+.size sTaskSaveRegisters, .-sTaskSaveRegisters
+
+.section .text.sTaskRestoreRegisters,"ax",%progbits
+.type sTaskRestoreRegisters, %function
+sTaskRestoreRegisters:
+// argument r0: is TaskHandle for the task you want to restore it registers
+// argument r3: EXC_RETURN of the current exception, returns the EXC_RETURN of the task
+// note: r1 and r12 are changed in this routine
+    ldr     r1, [r0, #12]               // task->stackBase
+    add     r1, r1, #CONTEXT_LIMIT_OFFSET
+    msr     psplim, r1                  // stack overflow is now caught by the hardware
+    ldr     r1, [r0]                    // task sp
+    ldrb    r12, [r0, #8]               // Task->fps
+    cmp     r12, #1                     // check if an extended frame was saved
+    itte    eq
+    vldmiaeq r1!, {s16-s31}             // restore s16-s31, the hardware restores s0-s15 and fpscr
+    biceq   r3, r3, #0x10               // return with an extended frame
+    orrne   r3, r3, #0x10               // return with a basic frame
+    ldmia   r1!, {r8-r11}               //
+    ldmia   r1!, {r4-r7}                //
+    msr     psp, r1                     // the hardware frame is popped from PSP on exception return
+    mov     r1, #0
+    strb    r1, [r0, #11]               // change RegitersSaved to false
+    bx      lr
+.size sTaskRestoreRegisters, .-sTaskRestoreRegisters
+
+
+
+.section .text.sScheduler_Handler,"ax",%progbits
+.type sScheduler_Handler, %function
+sScheduler_Handler:                     // r0,r1,r2,r3,r12,lr,pc,psr   saved by interrupt
+    push    {lr}                        // save return address
+    bl      _sRTOSGetFirstAvailableTask // returns the first highest ready task
+    pop     {lr}                        // restore return address
+    cmp     r0, #0                      // if AvailableTask is null then keep executing current task
+    beq     2f                          // if eq to NULL then return execution to current task
+    mov     r2, r0
+    ldr     r0, =_sCurrentTask          // the _sCurrentTask return the current task (r0 is the return value)
+    ldr     r0, [r0]                    // load the addres of current task
+    mov     r3, lr
+    bl      sTaskSaveRegisters
+    ldrb    r1, [r0, #9]                // read current status
+    cmp     r1, #1                      // check if the task status is running (the status cloud change by a timer if so the register are saved)
+    itt     eq
+    moveq   r1, #2                      // sReady:0x02
+    strbeq  r1, [r0, #9]                // change current task status to sReady
+    mov     r0, r2                      // copy firstAvailableTask addr into r0
+    bl      sTaskRestoreRegisters
+    mov     lr, r3                      // EXC_RETURN of the next task
+    mov     r1, #1                      // sRunning:0x1
+    strb    r1, [r0, #9]                // change next task status to sRunning
+
+    ldr     r1, =_sCurrentTask
+    str     r0, [r1]                    // change the current running task ptr
+2:
+    sKernelUnlock
+    bx      lr                          // return and start the next task
+.size sScheduler_Handler, .-sScheduler_Handler
+
+
+
+.section .text.sTimer_Handler,"ax",%progbits
+.type sTimer_Handler, %function
+sTimer_Handler:                         // r0,r1,r2,r3,r12,lr,pc,psr   saved by interrupt
+    ldr     r2, =_sIsTimerRunning
+    mov     r1, #1
+    str     r1, [r2]                    // change the _sIsTimerRunning to true
+    mov     r2, r0                      // save a copy of r0 which is the the timerHandle
+    ldr     r0, =_sCurrentTask          // the _sCurrentTask return the current task (r0 is the return value)
+    ldr     r0, [r0]
+
+    mov     r3, lr
+    bl      sTaskSaveRegisters
+    orr     lr, r3, #0x10               // the callback frame is a basic frame
+
+    mov     r0, r2                      // restore the the timerHandle to r0, because it the argument to the for the timer
+#if __sUSE_TIMER_DAEMON == 0
+    ldr     r1, =__TimerStack
+    msr     psplim, r1                  // limit of the shared timer stack (callbacks are never switched out)
+#endif
+    ldr     r1, [r0]
+    msr     psp, r1                     // PSP = Timer Task
+    sKernelUnlock
+    bx      lr                          // return and start the timer callback
+.size sTimer_Handler, .-sTimer_Handler
+
+
+
+.section .text.sTimerReturn_Handler,"ax",%progbits
+.type sTimerReturn_Handler, %function
+sTimerReturn_Handler:                   // entered from SVC_Handler, the kernel is already locked
+    ldr     r0, =_sCurrentTask          // the _sCurrentTask return the current task (r0 is the return value)
+    ldr     r0, [r0]
+    mov     r3, lr
+    bl      sTaskRestoreRegisters
+    mov     lr, r3                      // EXC_RETURN of the task
+    b       Timer_return                // rerun the scheduler in case the timer run at the end of quantum (which mean that the next task should run)
+.size sTimerReturn_Handler, .-sTimerReturn_Handler
+
+
+
+.section .text.sRTOSStartScheduler,"ax",%progbits
+.type sRTOSStartScheduler, %function
+sRTOSStartScheduler:
+    cpsid   i                           // disable isr
+    bl      _sRTOSGetFirstAvailableTask // returns the first highest ready task (main is never returned to)
+    ldr     r1, [r0, #12]               // task->stackBase
+    add     r1, r1, #CONTEXT_LIMIT_OFFSET
+    msr     psplim, r1
+    ldr     r1, [r0]                    // task sp
+    add     r1, r1, #32                 // skip r8-r11, r4-r7 (the first frame is always a basic frame)
+    ldr     lr, [r1, #20]               // lr of the frame: _taskReturn
+    ldr     r12, [r1, #24]              // pc of the frame: the task
+    ldr     r3, [r1]                    // r0 of the frame: the task argument
+    add     r1, r1, #32                 // the whole frame is popped
+    msr     psp, r1
+    mov     r1, #2                      // CONTROL.SPSEL: thread mode uses PSP
+    msr     control, r1
+    isb
+    ldr     r1, =0xE000ED08             // VTOR
+    ldr     r1, [r1]
+    ldr     r1, [r1]                    // initial MSP from the vector table
+    msr     msp, r1                     // the stack of main is given back to the exception handlers
+    mov     r2, #1                      // sRunning:0x1
+    strb    r2, [r0, #9]                // change task status to sRunning
+    mov     r2, #0
+    strb    r2, [r0, #11]               // change regitersSaved to false (because registers are restored)
+    ldr     r2, =_sCurrentTask          // get the address of _sCurrentTask
+    str     r0, [r2]                    // save the current task ptr
+    mov     r0, r3
+    ldr     r2, =0xE000E010             // #define SYST_CSR (*((volatile uint32_t *)0xE000E010))
+    movs    r1, #7                      // ENABLE | TICKINT | CLKSOURCE
+    str     r1, [r2]                    // enable SysTick, enable exception, select processor clock
+    cpsie   i                           // enable irq
+    bx      r12                         // start the task
+.size sRTOSStartScheduler, .-sRTOSStartScheduler
+
+#endif
@@ -0,0 +1,175 @@
+/*
+ * simpleRTOSBasicTask.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: brachiGH
+ */
+
+#include "simpleRTOS.h"
+#include "string.h"
+
+#if __sUSE_BASIC_TASKS == 1
+
+extern void _insertTask(sTaskHandle_t *task);
+extern void _deleteTask(sTaskHandle_t *task, sbool_t freeMem);
+
+#if __sUSE_LATENCY_STATS == 1
+extern void _sLatencyReady(sTaskHandle_t *task);
+#endif
+
+extern sTaskHandle_t *_sCurrentTask;
+
+// words the context switch saves below the stack pointer of a preempted basic task
+#if defined(__ARM_ARCH_8M_MAIN__)
+#define BASIC_TASK_SAVE_WORDS (CONTEXT_STACK_SIZE + 16) // r4-r11, and s16-s31 if the task used the FPU
+#else
+#define BASIC_TASK_SAVE_WORDS CONTEXT_STACK_SIZE // r4-r11 (basic tasks have no FPU frame)
+#endif
+
+/*
+ * Basic tasks never block, and a basic task only starts above the basic tasks of
+ * a strictly lower priority, so their frames nest on one stack like interrupts:
+ * the started basic tasks form a stack (__BasicTaskTop), only the top one can run,
+ * the ones below it always have a lower priority.
+ */
+static sUBaseType_t __BasicTaskStack[STACK_LIMIT_GUARD_WORDS + __sBASIC_TASK_STACK_DEPTH] __attribute__((aligned(8)));
+static sBasicTask_t *__BasicTaskTop = NULL; // last started basic task, NULL if the basic task stack is empty
+
+// the basic task returned: its frame is dropped and it waits for the next activation
+static void _basicTaskReturn(void)
+{
+  sBasicTask_t *task = (sBasicTask_t *)_sCurrentTask;
+
+  __sCriticalRegionBegin();
+  __BasicTaskTop = task->preempted;
+  task->started = sFalse;
+  task->tcb.status = sBlocked;
+  _deleteTask(&task->tcb, sFalse);
+  __sCriticalRegionEnd();
+
+  sRTOSTaskYield(); // the next activation starts from a new frame, this one is never resumed
+  for (;;)
+  {
+  }
+}
+
+// writes the first frame of task below the live frames of the basic task stack,
+// the exception return then enters task->func like a function call
+static void __basicTaskStart(sBasicTask_t *task)
+{
+  sUBaseType_t *top;
+  if (_sCurrentTask->isBasic)
+  {
+    // the running task is on the basic task stack, its context is saved below its stack pointer right after this
+    sUBaseType_t psp;
+    __asm volatile("mrs %0, psp" : "=r"(psp));
+    top = (sUBaseType_t *)psp - BASIC_TASK_SAVE_WORDS;
+  }
+  else if (__BasicTaskTop != NULL)
+  {
+    top = __BasicTaskTop->tcb.stackPt;
+  }
+  else
+  {
+    top = &__BasicTaskStack[STACK_LIMIT_GUARD_WORDS + __sBASIC_TASK_STACK_DEPTH];
+  }
+  top = (sUBaseType_t *)((sUBaseType_t)top & ~7u); // the hardware frame is 8-byte aligned
+
+  // r8-r11 and r4-r7 are not initialized, a function call does not expect any value in them
+  sUBaseType_t *frame = top - MIN_STACK_SIZE_NO_FPU;
+  frame[CONTEXT_STACK_SIZE + 0] = (sUBaseType_t)task->arg;         // R0
+  frame[CONTEXT_STACK_SIZE + 5] = (sUBaseType_t)(_basicTaskReturn); // LR
+  frame[CONTEXT_STACK_SIZE + 6] = (sUBaseType_t)(task->func);       // PC
+  frame[CONTEXT_STACK_SIZE + 7] = 0x01000000;                       // xPSR
+
+  task->tcb.stackPt = frame;
+  task->tcb.regitersSaved = sTrue;
+  task->tcb.fps = sFalse;
+  task->started = sTrue;
+  task->preempted = __BasicTaskTop;
+  __BasicTaskTop = task;
+}
+
+// called by the scheduler with the task it picked from the ready list list,
+// returns the task to switch to
+sTaskHandle_t *_sBasicTaskDispatch(sTaskHandle_t *task, sTaskHandle_t **list)
+{
+  if (!task->isBasic || ((sBasicTask_t *)task)->started)
+    return task;
+
+  if (__BasicTaskTop != NULL && task->priority <= __BasicTaskTop->tcb.priority)
+  {
+    // it can not start above a basic task of the same priority: the next task of the list
+    // that is not a new basic task runs instead (at least __BasicTaskTop is in this list)
+    while (task->isBasic && !((sBasicTask_t *)task)->started)
+    {
+      task = task->nextTask;
+    }
+    *list = task->nextTask;
+    return task;
+  }
+
+  __basicTaskStart((sBasicTask_t *)task);
+  return task;
+}
+
+// returns sFalse if the task is already active
+static sbool_t _basicTaskActivate(sBasicTask_t *task, sbool_t *higherPriorityWoken)
+{
+  *higherPriorityWoken = sFalse;
+
+  __sCriticalRegionBegin();
+  if (task->tcb.status != sBlocked)
+  {
+    __sCriticalRegionEnd();
+    return sFalse;
+  }
+
+  task->tcb.status = sReady;
+  _insertTask(&task->tcb);
+#if __sUSE_LATENCY_STATS == 1
+  _sLatencyReady(&task->tcb);
+#endif
+  *higherPriorityWoken = (sbool_t)(task->tcb.priority > _sCurrentTask->priority);
+  __sCriticalRegionEnd();
+  return sTrue;
+}
+
+sbool_t sRTOSBasicTaskActivate(sBasicTask_t *task)
+{
+  sbool_t yield;
+  sbool_t activated = _basicTaskActivate(task, &yield);
+  __sYieldIfWoken(yield);
+  return activated;
+}
+
+sbool_t sRTOSBasicTaskActivateFromISR(sBasicTask_t *task, sbool_t *higherPriorityWoken)
+{
+  sbool_t woken; // the task starts at the next tick, or when the ISR returns with sRTOSYieldFromISR
+  sbool_t activated = _basicTaskActivate(task, &woken);
+  __sReportWoken(higherPriorityWoken, woken);
+  return activated;
+}
+
+sRTOS_StatusTypeDef sRTOSBasicTaskCreate(sTaskFunc_t taskFunc, char *name, void *arg, sPriority_t priority, sBasicTask_t *task)
+{
+  if (taskFunc == NULL || priority < sPriorityMin || priority > sPriorityMax)
+    return sRTOS_ERROR;
+
+  memset(task, 0, sizeof(sBasicTask_t));
+  task->func = taskFunc;
+  task->arg = arg;
+  task->tcb.stackBase = __BasicTaskStack; // stack limit of every basic task on ARMv8-M
+  task->tcb.nextTask = &task->tcb;
+  task->tcb.prevTask = &task->tcb;
+  task->tcb.status = sBlocked; // suspended until it is activated
+  task->tcb.priority = priority;
+  task->tcb.originalPriority = priority;
+  task->tcb.inheritedPriority = sPriorityMin;
+  task->tcb.isStatic = sTrue; // the shared stack is never freed
+  task->tcb.isBasic = sTrue;
+  strncpy(task->tcb.name, name, MAX_TASK_NAME_LEN);
+  return sRTOS_OK;
+}
+
+#endif
@@ -0,0 +1,160 @@
+/*
+ * simpleRTOSBudget.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: brachiGH
+ */
+
+#include "simpleRTOS.h"
+
+#if __sUSE_CPU_BUDGETS == 1
+
+extern void _insertTask(sTaskHandle_t *task);
+extern void _deleteTask(sTaskHandle_t *task, sbool_t freeMem);
+extern sbool_t _sRestoreTaskPriority(sTaskHandle_t *task);
+#if __sUSE_LATENCY_STATS == 1
+extern void _sLatencyReady(sTaskHandle_t *task);
+#endif
+
+extern sTaskHandle_t *_sCurrentTask;
+extern volatile sUBaseType_t _sTicksPassedExecutingCurrentTask;
+
+/*
+ * A task with a budget can run budget ticks per period. The period starts at the first
+ * tick charged after the previous one ended, so a task that sleeps does not bank time.
+ * An exhausted task is throttled (demoted to sPriorityIdle or suspended) and kept in the
+ * throttled list, which SysTick scans for the replenishments: it only holds the throttled
+ * tasks, and the ticks of the other tasks only cost a compare.
+ */
+static sTaskHandle_t *__ThrottledTasks = NULL;
+
+// note: must be called inside a critical region
+static void __budgetThrottle(sTaskHandle_t *task)
+{
+  task->budgetThrottled = sTrue;
+  task->nextThrottled = __ThrottledTasks;
+  __ThrottledTasks = task;
+
+  if (task->budgetPolicy == sBudgetSuspend)
+  {
+    _deleteTask(task, sFalse);
+    task->status = sBlocked;
+    task->budgetSuspended = sTrue;
+  }
+  else
+  {
+    _sRestoreTaskPriority(task); // sPriorityIdle, a lock holder keeps the priority it inherited
+  }
+
+  _sTicksPassedExecutingCurrentTask = __sQUANTA_EXPIRED; // the scheduler runs after this tick
+}
+
+// note: must be called inside a critical region
+static void __budgetReplenish(sTaskHandle_t *task)
+{
+  task->budgetThrottled = sFalse;
+  task->budgetLeft = task->budget;
+
+  if (task->budgetSuspended)
+  {
+    task->budgetSuspended = sFalse;
+    task->status = sReady;
+    _insertTask(task);
+#if __sUSE_LATENCY_STATS == 1
+    _sLatencyReady(task);
+#endif
+  }
+  else
+  {
+    _sRestoreTaskPriority(task);
+  }
+}
+
+// called by _sTaskTick on every tick, the kernel is locked
+void _sBudgetTick(void)
+{
+  sTick_t now = sGetTick();
+
+  sTaskHandle_t **link = &__ThrottledTasks;
+  while (*link != NULL)
+  {
+    sTaskHandle_t *task = *link;
+    if (now >= task->budgetReplenish)
+    {
+      *link = task->nextThrottled;
+      task->nextThrottled = NULL;
+      __budgetReplenish(task);
+    }
+    else
+    {
+      link = &task->nextThrottled;
+    }
+  }
+
+  sTaskHandle_t *task = _sCurrentTask;
+  if (task->budget == 0 || task->budgetThrottled || task->status != sRunning)
+    return;
+
+  if (now >= task->budgetReplenish)
+  {
+    // first tick of a new period
+    task->budgetLeft = task->budget;
+    task->budgetReplenish = now + task->budgetPeriod;
+  }
+
+  task->budgetLeft--;
+  if (task->budgetLeft == 0)
+    __budgetThrottle(task);
+}
+
+// removes a deleted task from the throttled list
+// note: must be called inside a critical region
+void _sBudgetForget(sTaskHandle_t *task)
+{
+  if (!task->budgetThrottled)
+    return;
+
+  for (sTaskHandle_t **link = &__ThrottledTasks; *link != NULL; link = &(*link)->nextThrottled)
+  {
+    if (*link == task)
+    {
+      *link = task->nextThrottled;
+      break;
+    }
+  }
+  task->nextThrottled = NULL;
+  task->budgetThrottled = sFalse;
+  task->budgetSuspended = sFalse;
+}
+
+sRTOS_StatusTypeDef sRTOSTaskSetBudget(sTaskHandle_t *taskHandle, sUBaseType_t budgetTicks, sUBaseType_t periodTicks, sBudgetPolicy_t policy)
+{
+  if (taskHandle == NULL)
+    taskHandle = _sCurrentTask;
+
+  if (budgetTicks != 0 && (periodTicks == 0 || budgetTicks > periodTicks))
+    return sRTOS_ERROR;
+  if (policy != sBudgetDemote && policy != sBudgetSuspend)
+    return sRTOS_ERROR;
+  if (policy == sBudgetSuspend && taskHandle->isBasic)
+    return sRTOS_ERROR; // a basic task must run to completion once started
+
+  __sCriticalRegionBegin();
+  if (taskHandle->budgetThrottled)
+  {
+    // the new budget starts now, the throttling of the old one is undone
+    sbool_t suspended = taskHandle->budgetSuspended;
+    _sBudgetForget(taskHandle);
+    taskHandle->budgetSuspended = suspended;
+    __budgetReplenish(taskHandle);
+  }
+  taskHandle->budget = budgetTicks;
+  taskHandle->budgetLeft = budgetTicks;
+  taskHandle->budgetPeriod = periodTicks;
+  taskHandle->budgetPolicy = (uint8_t)policy;
+  taskHandle->budgetReplenish = sGetTick() + periodTicks;
+  __sCriticalRegionEnd();
+  return sRTOS_OK;
+}
+
+#endif
@@ -0,0 +1,241 @@
+/*
+ * simpleRTOSCoroutine.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: brachiGH
+ */
+
+#include "simpleRTOS.h"
+
+#if __sUSE_COROUTINES == 1
+
+extern sbool_t _sBlockCurrentTask(sUBaseType_t timeoutTicks);
+extern void _sWakeTask(sTaskHandle_t *task);
+extern void _changeTaskPriority(sTaskHandle_t *task, sPriority_t priority);
+extern sbool_t _sInsertCoroutineTimeout(sCoroutine_t *co, sTick_t deadline);
+extern void _removeCoroutineTimeoutList(sCoroutine_t *co);
+
+extern sTaskHandle_t *_sCurrentTask;
+
+/*
+ * Every coroutine runs on the stack of one kernel task, the coroutine scheduler.
+ * Ready coroutines are kept in per priority lists with their own bitmap, and the
+ * scheduler task always runs at the priority of the highest ready coroutine, so a
+ * coroutine is scheduled against the tasks as if it were a task of its priority.
+ * Coroutines of the same priority run in FIFO order, a coroutine is never preempted
+ * by another coroutine (only by tasks and interrupts).
+ */
+sTaskHandle_t __CoroutineTask;
+static sCoroutine_t *__CoroutineReadyTail[MAX_TASK_PRIORITY_COUNT] = {NULL}; // circular lists, tail->next is the head
+static volatile sUBaseType_t __CoroutinePriorityBitMap = 0x0;
+static volatile sbool_t __CoroutineSchedulerIdle = sFalse; // the scheduler task is blocked, no coroutine is ready
+
+// note: must be called inside a critical region
+static void __setSchedulerPriority(sPriority_t priority)
+{
+  if (__CoroutineTask.originalPriority == priority)
+    return;
+
+  __CoroutineTask.originalPriority = priority; // _sRTOSGetFirstAvailableTask restores the task to this priority
+  _changeTaskPriority(&__CoroutineTask, priority);
+}
+
+// appends co at the end of its ready list and raises the scheduler task to its priority
+// note: must be called inside a critical region
+static void __coroutineReady(sCoroutine_t *co)
+{
+  sUBaseType_t priorityIndex = co->priority + (MAX_TASK_PRIORITY_COUNT / 2);
+  sCoroutine_t *tail = __CoroutineReadyTail[priorityIndex];
+
+  co->status = sReady;
+  if (tail == NULL)
+  {
+    co->next = co;
+  }
+  else
+  {
+    co->next = tail->next;
+    tail->next = co;
+  }
+  __CoroutineReadyTail[priorityIndex] = co;
+  __CoroutinePriorityBitMap |= 1u << priorityIndex;
+
+  if (co->priority > __CoroutineTask.originalPriority)
+    __setSchedulerPriority(co->priority);
+
+  if (__CoroutineSchedulerIdle)
+  {
+    __CoroutineSchedulerIdle = sFalse;
+    _sWakeTask(&__CoroutineTask);
+  }
+}
+
+// note: must be called inside a critical region, the list must not be empty
+static sCoroutine_t *__popReadyCoroutine(sUBaseType_t priorityIndex)
+{
+  sCoroutine_t *tail = __CoroutineReadyTail[priorityIndex];
+  sCoroutine_t *head = tail->next;
+
+  if (head == tail)
+  {
+    __CoroutineReadyTail[priorityIndex] = NULL;
+    __CoroutinePriorityBitMap &= ~(1u << priorityIndex);
+  }
+  else
+  {
+    tail->next = head->next;
+  }
+  head->next = NULL;
+  return head;
+}
+
+// called by SysTick when the timeout of a waiting coroutine expires (inside a critical region)
+void _sCoroutineTimeout(sCoroutine_t *co)
+{
+  if (co->notificationState == sNotificationWaiting)
+    co->notificationState = sNotificationEmpty; // a later notification must not ready it a second time
+  __coroutineReady(co);
+}
+
+sbool_t _sCoroutineWait(sCoroutine_t *co, sUBaseType_t timeoutTicks, sbool_t notification)
+{
+  __sCriticalRegionBegin();
+  if (notification && (co->notificationState == sNotificationPending || timeoutTicks == 0))
+  {
+    __sCriticalRegionEnd();
+    return sFalse;
+  }
+
+  if (timeoutTicks == __sMAX_DELAY)
+  {
+    co->status = sBlocked;
+  }
+  else
+  {
+    // checking the notification and inserting the timeout are done in the same critical region so a notification can not be missed
+    if (!_sInsertCoroutineTimeout(co, __sTickDeadline(sGetTick(), timeoutTicks)))
+    {
+      __sCriticalRegionEnd();
+      return sFalse;
+    }
+    co->status = sWaiting;
+  }
+
+  if (notification)
+    co->notificationState = sNotificationWaiting;
+  __sCriticalRegionEnd();
+  return sTrue;
+}
+
+sUBaseType_t _sCoroutineTakeNotification(sCoroutine_t *co)
+{
+  __sCriticalRegionBegin();
+  sUBaseType_t value = (co->notificationState == sNotificationPending) ? co->notificationValue : 0; // 0 on timeout
+  co->notificationValue = 0;
+  co->notificationState = sNotificationEmpty;
+  __sCriticalRegionEnd();
+  return value;
+}
+
+// returns sTrue if the scheduler task now has a higher priority than the current task
+static sbool_t _pushCoroutineNotification(sCoroutine_t *co, sUBaseType_t message)
+{
+  sbool_t higherPriorityWoken = sFalse;
+
+  __sCriticalRegionBegin();
+  sNotificationState_t state = co->notificationState;
+  co->notificationValue = message;
+  co->notificationState = sNotificationPending;
+
+  // a coroutine that is already ready or running only keeps the pending value
+  if (state == sNotificationWaiting && (co->status == sWaiting || co->status == sBlocked))
+  {
+    if (co->status == sWaiting)
+      _removeCoroutineTimeoutList(co);
+    __coroutineReady(co);
+    higherPriorityWoken = (sbool_t)(__CoroutineTask.priority > _sCurrentTask->priority);
+  }
+  __sCriticalRegionEnd();
+  return higherPriorityWoken;
+}
+
+void sRTOSCoroutineNotify(sCoroutine_t *co, sUBaseType_t message)
+{
+  __sYieldIfWoken(_pushCoroutineNotification(co, message));
+}
+
+void sRTOSCoroutineNotifyFromISR(sCoroutine_t *co, sUBaseType_t message, sbool_t *higherPriorityWoken)
+{
+  // the woken coroutine runs at the next tick, or when the ISR returns with sRTOSYieldFromISR
+  __sReportWoken(higherPriorityWoken, _pushCoroutineNotification(co, message));
+}
+
+sRTOS_StatusTypeDef sRTOSCoroutineCreate(sCoroutineFunc_t func, void *arg, sPriority_t priority, sCoroutine_t *co)
+{
+  if (func == NULL || priority < sPriorityMin || priority > sPriorityMax)
+    return sRTOS_ERROR;
+
+  co->func = func;
+  co->arg = arg;
+  co->resumePoint = 0;
+  co->priority = priority;
+  co->notificationState = sNotificationEmpty;
+  co->notificationValue = 0;
+
+  __sCriticalRegionBegin();
+  __coroutineReady(co);
+  __sCriticalRegionEnd();
+  return sRTOS_OK;
+}
+
+static void _coroutineScheduler(void *)
+{
+  for (;;)
+  {
+    __sCriticalRegionBegin();
+    if (__CoroutinePriorityBitMap == 0)
+    {
+      // checking the lists and blocking are done in the same critical region so a wake up can not be missed
+      __CoroutineSchedulerIdle = sTrue;
+      _sBlockCurrentTask(__sMAX_DELAY);
+      __sCriticalRegionEnd();
+      sRTOSTaskYield();
+      continue;
+    }
+
+    sUBaseType_t priorityIndex = __sHighestBit(__CoroutinePriorityBitMap);
+    sPriority_t priority = (sPriority_t)((sBaseType_t)priorityIndex - (MAX_TASK_PRIORITY_COUNT / 2));
+    if (priority < __CoroutineTask.originalPriority)
+    {
+      // the tasks between the two priorities run before the next coroutine
+      __setSchedulerPriority(priority);
+      __sCriticalRegionEnd();
+      sRTOSTaskYield();
+      continue;
+    }
+
+    sCoroutine_t *co = __popReadyCoroutine(priorityIndex);
+    co->status = sRunning;
+    __sCriticalRegionEnd();
+
+    co->func(co, co->arg); // runs until the coroutine waits, yields or ends
+
+    __sCriticalRegionBegin();
+    if (co->status == sRunning) // sCO_YIELD, or a wait that did not block
+      __coroutineReady(co);
+    __sCriticalRegionEnd();
+  }
+}
+
+sRTOS_StatusTypeDef _sCoroutineSchedulerCreate(void)
+{
+  return sRTOSTaskCreate(_coroutineScheduler,
+                         "coroutines",
+                         NULL,
+                         __sCOROUTINE_STACK_DEPTH,
+                         sPriorityIdle,
+                         &__CoroutineTask,
+                         srFALSE);
+}
+
+#endif
@@ -0,0 +1,110 @@
+/*
+ * simpleRTOSDeferredWork.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: brachiGH
+ */
+
+#include "simpleRTOS.h"
+
+#if __sUSE_DEFERRED_WORK == 1
+
+#if (__sDEFERRED_QUEUE_LENGTH & (__sDEFERRED_QUEUE_LENGTH - 1)) != 0
+#error "__sDEFERRED_QUEUE_LENGTH must be a power of 2"
+#endif
+
+extern sbool_t _sBlockCurrentTask(sUBaseType_t timeoutTicks);
+extern void _sWakeTask(sTaskHandle_t *task);
+
+extern sTaskHandle_t *_sCurrentTask;
+
+typedef struct
+{
+  sDeferredFunc_t func;
+  void *arg;
+} sDeferredWork_t;
+
+sTaskHandle_t __DeferredWorkTask;
+static sDeferredWork_t __DeferredQueue[__sDEFERRED_QUEUE_LENGTH];
+// head and tail are free running, the slot is the index modulo __sDEFERRED_QUEUE_LENGTH
+static volatile sUBaseType_t __DeferredQueueHead = 0; // only written by the deferred work task
+static volatile sUBaseType_t __DeferredQueueTail = 0; // reserved by ISRs with LDREX/STREX
+static volatile sbool_t __DeferredWorkIdle = sFalse;  // the task is blocked waiting for work
+
+/*
+ * Several ISRs (nested) can append at the same time, each one reserves its slot
+ * by moving the tail with LDREX/STREX, then fills it.
+ * The task only reads the ring from thread mode, an ISR that reserved a slot
+ * has always filled it before the task can run again.
+ */
+sbool_t sRTOSDeferFromISR(sDeferredFunc_t func, void *arg, sbool_t *higherPriorityWoken)
+{
+  sUBaseType_t tail;
+  do
+  {
+    tail = __sLoadExclusive(&__DeferredQueueTail);
+    if (tail - __DeferredQueueHead >= __sDEFERRED_QUEUE_LENGTH)
+    {
+      __sClearExclusive();
+      return sFalse;
+    }
+  } while (__sStoreExclusive(&__DeferredQueueTail, tail + 1));
+
+  __DeferredQueue[tail & (__sDEFERRED_QUEUE_LENGTH - 1)].func = func;
+  __DeferredQueue[tail & (__sDEFERRED_QUEUE_LENGTH - 1)].arg = arg;
+
+  if (__DeferredWorkIdle)
+  {
+    __sCriticalRegionBegin();
+    if (__DeferredWorkIdle) // a nested ISR may have woken the task already
+    {
+      __DeferredWorkIdle = sFalse;
+      _sWakeTask(&__DeferredWorkTask);
+      __sReportWoken(higherPriorityWoken, (sbool_t)(__DeferredWorkTask.priority > _sCurrentTask->priority));
+    }
+    __sCriticalRegionEnd();
+  }
+  return sTrue;
+}
+
+static void _deferredWork(void *)
+{
+  for (;;)
+  {
+    __sCriticalRegionBegin();
+    if (__DeferredQueueHead == __DeferredQueueTail)
+    {
+      // checking the ring and blocking are done in the same critical region so a wake up can not be missed
+      __DeferredWorkIdle = sTrue;
+      _sBlockCurrentTask(__sMAX_DELAY);
+      __sCriticalRegionEnd();
+      sRTOSTaskYield();
+      continue;
+    }
+    __sCriticalRegionEnd();
+
+    // run the whole batch, work deferred meanwhile is picked up by the next loop
+    sUBaseType_t tail = __DeferredQueueTail;
+    sUBaseType_t head = __DeferredQueueHead;
+    while (head != tail)
+    {
+      sDeferredWork_t *work = &__DeferredQueue[head & (__sDEFERRED_QUEUE_LENGTH - 1)];
+      work->func(work->arg);
+      head++;
+      __DeferredQueueHead = head; // frees the slot
+    }
+  }
+}
+
+sRTOS_StatusTypeDef _sDeferredWorkCreate(void)
+{
+  return sRTOSTaskCreate(_deferredWork,
+                         "deferred",
+                         NULL,
+                         __sDEFERRED_WORK_STACK_DEPTH,
+                         __sDEFERRED_WORK_PRIORITY,
+                         &__DeferredWorkTask,
+                         srFALSE);
+}
+
+#endif
@@ -0,0 +1,166 @@
+/*
+ * simpleRTOSFairShare.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: brachiGH
+ */
+
+#include "simpleRTOS.h"
+
+#if __sUSE_FAIR_SHARE == 1
+
+#if __sFAIR_SHARE_MAX_TASKS < 1 || __sFAIR_SHARE_MAX_TASKS > 254
+#error "__sFAIR_SHARE_MAX_TASKS must be between 1 and 254"
+#endif
+#if __sFAIR_SHARE_DEFAULT_WEIGHT < 1 || __sFAIR_SHARE_DEFAULT_WEIGHT > 255
+#error "__sFAIR_SHARE_DEFAULT_WEIGHT must be between 1 and 255"
+#endif
+
+extern sTaskHandle_t *_sCurrentTask;
+
+#if __sUSE_PARTITIONS == 1
+#define FAIR_HEAPS __sPARTITION_COUNT
+#define PARTITION_OF(task) ((task)->partition)
+#else
+#define FAIR_HEAPS 1
+#define PARTITION_OF(task) 0
+#endif
+
+#define VRUNTIME_SCALE 0x10000u // virtual runtime of one tick at weight 1
+
+/*
+ * The ready tasks of __sFAIR_SHARE_PRIORITY are kept in a binary min-heap ordered by
+ * virtual runtime (one per partition, a partition has its own ready lists). Every tick
+ * charges VRUNTIME_SCALE / weight to the running task, and at the end of a slice the
+ * scheduler takes the top of the heap instead of the next task of the list: over time
+ * each task gets a share of the level proportional to its weight.
+ * The tasks stay in their ready list, the heap only orders them. A task that becomes ready
+ * starts at the smallest virtual runtime of the level, so a task that slept does not get
+ * the time it did not use.
+ */
+static sTaskHandle_t *__FairHeap[FAIR_HEAPS][__sFAIR_SHARE_MAX_TASKS];
+static sUBaseType_t __FairHeapSize[FAIR_HEAPS] = {0};
+static sUBaseType_t __FairMinVruntime[FAIR_HEAPS] = {0}; // virtual runtime of the level, only moves forward
+
+__STATIC_FORCEINLINE__ sbool_t __vruntimeBefore(sUBaseType_t a, sUBaseType_t b)
+{
+  return (sbool_t)((sBaseType_t)(a - b) < 0); // virtual runtimes wrap around, they are close to each other
+}
+
+static void __heapSet(sTaskHandle_t **heap, sUBaseType_t i, sTaskHandle_t *task)
+{
+  heap[i] = task;
+  task->fairIndex = (uint8_t)(i + 1);
+}
+
+static void __siftUp(sTaskHandle_t **heap, sUBaseType_t i)
+{
+  sTaskHandle_t *task = heap[i];
+  while (i > 0)
+  {
+    sUBaseType_t parent = (i - 1) / 2;
+    if (!__vruntimeBefore(task->vruntime, heap[parent]->vruntime))
+      break;
+    __heapSet(heap, i, heap[parent]);
+    i = parent;
+  }
+  __heapSet(heap, i, task);
+}
+
+static void __siftDown(sTaskHandle_t **heap, sUBaseType_t size, sUBaseType_t i)
+{
+  sTaskHandle_t *task = heap[i];
+  for (;;)
+  {
+    sUBaseType_t child = 2 * i + 1;
+    if (child >= size)
+      break;
+    if (child + 1 < size && __vruntimeBefore(heap[child + 1]->vruntime, heap[child]->vruntime))
+      child++;
+    if (!__vruntimeBefore(heap[child]->vruntime, task->vruntime))
+      break;
+    __heapSet(heap, i, heap[child]);
+    i = child;
+  }
+  __heapSet(heap, i, task);
+}
+
+// note: must be called inside a critical region
+void _sFairShareInsert(sTaskHandle_t *task)
+{
+  sUBaseType_t partition = PARTITION_OF(task);
+  if (__FairHeapSize[partition] == __sFAIR_SHARE_MAX_TASKS)
+    return; // the level falls back to round-robin until a task leaves (see _sFairSharePick)
+
+  if (__vruntimeBefore(task->vruntime, __FairMinVruntime[partition]))
+    task->vruntime = __FairMinVruntime[partition];
+
+  sUBaseType_t i = __FairHeapSize[partition]++;
+  __FairHeap[partition][i] = task;
+  __siftUp(__FairHeap[partition], i);
+}
+
+// note: must be called inside a critical region
+void _sFairShareRemove(sTaskHandle_t *task)
+{
+  if (task->fairIndex == 0)
+    return;
+
+  sUBaseType_t partition = PARTITION_OF(task);
+  sTaskHandle_t **heap = __FairHeap[partition];
+  sUBaseType_t i = task->fairIndex - 1;
+  sUBaseType_t last = --__FairHeapSize[partition];
+  task->fairIndex = 0;
+
+  if (i == last)
+    return;
+
+  // the last task takes the hole, then moves up or down to its place
+  __heapSet(heap, i, heap[last]);
+  if (i > 0 && __vruntimeBefore(heap[i]->vruntime, heap[(i - 1) / 2]->vruntime))
+    __siftUp(heap, i);
+  else
+    __siftDown(heap, last, i);
+}
+
+// called by _sTaskTick on every tick, the kernel is locked
+void _sFairShareTick(void)
+{
+  sTaskHandle_t *task = _sCurrentTask;
+  if (task->fairIndex == 0 || task->status != sRunning)
+    return;
+
+  sUBaseType_t weight = task->fairWeight ? task->fairWeight : __sFAIR_SHARE_DEFAULT_WEIGHT;
+  sUBaseType_t partition = PARTITION_OF(task);
+  task->vruntime += VRUNTIME_SCALE / weight;
+  __siftDown(__FairHeap[partition], __FairHeapSize[partition], task->fairIndex - 1);
+}
+
+// head: first task of the ready list of the level the scheduler picks from,
+// returns the task with the least virtual runtime, or NULL to keep the round-robin order
+// (when more tasks are ready than the heap holds, or tasks were linked at build time by tools/sRTOSgen.py)
+sTaskHandle_t *_sFairSharePick(sTaskHandle_t *head, sUBaseType_t readyTasks)
+{
+  sUBaseType_t partition = PARTITION_OF(head);
+  if (__FairHeapSize[partition] != readyTasks)
+    return NULL;
+
+  sTaskHandle_t *task = __FairHeap[partition][0];
+  if (__vruntimeBefore(__FairMinVruntime[partition], task->vruntime))
+    __FairMinVruntime[partition] = task->vruntime;
+  return task;
+}
+
+sRTOS_StatusTypeDef sRTOSTaskSetWeight(sTaskHandle_t *taskHandle, sUBaseType_t weight)
+{
+  if (taskHandle == NULL)
+    taskHandle = _sCurrentTask;
+
+  if (weight == 0 || weight > 255)
+    return sRTOS_ERROR;
+
+  taskHandle->fairWeight = (uint8_t)weight; // applies from the next tick charged, the virtual runtime already run is kept
+  return sRTOS_OK;
+}
+
+#endif
@@ -0,0 +1,298 @@
+/*
+ * simpleRTOSHRTimer.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: brachiGH
+ */
+
+#include "simpleRTOS.h"
+
+#if __sUSE_HRTIMER == 1
+
+#define NVIC_ISER ((volatile uint32_t *)0xE000E100)
+#define NVIC_ISPR ((volatile uint32_t *)0xE000E200)
+
+#if __sHRTIMER_PORT == __sHRTIMER_PORT_CMSDK
+/*
+ * CMSDK APB timers are 32-bit down counters that interrupt when they reach 0.
+ * TIMER0 runs free from 0xFFFFFFFF and gives the time base,
+ * TIMER1 is loaded with the distance to the next expiry and acts as the compare.
+ * The time base counts clock cycles, its wraps are counted in software (TIMER0 interrupts
+ * at every wrap) so that the microsecond count is derived from a 64-bit cycle count.
+ */
+#define TIMER0_CTRL (*((volatile uint32_t *)0x40000000))
+#define TIMER0_VALUE (*((volatile uint32_t *)0x40000004))
+#define TIMER0_RELOAD (*((volatile uint32_t *)0x40000008))
+#define TIMER0_INTCLEAR (*((volatile uint32_t *)0x4000000C))
+#define TIMER1_CTRL (*((volatile uint32_t *)0x40001000))
+#define TIMER1_VALUE (*((volatile uint32_t *)0x40001004))
+#define TIMER1_RELOAD (*((volatile uint32_t *)0x40001008))
+#define TIMER1_INTCLEAR (*((volatile uint32_t *)0x4000100C))
+
+#define TIMER_CTRL_EN (1u << 0)
+#define TIMER_CTRL_IRQEN (1u << 3)
+
+#define HRTIMER_IRQHandler TIMER1_Handler
+
+static sUBaseType_t __HRCountsPerUs = 1;
+static sUBaseType_t __HRWraps = 0;     // upper 32 bits of the cycle count
+static sUBaseType_t __HRLastCount = 0; // last count seen, a smaller count means the counter wrapped
+
+__STATIC_FORCEINLINE__ sUBaseType_t _hrCount(void)
+{
+  return 0xFFFFFFFFu - TIMER0_VALUE;
+}
+
+// note: the wrap interrupt guarantees that it runs at least once per wrap around
+static uint64_t _hrExtendedCount(void)
+{
+  __sCriticalRegionBegin();
+  sUBaseType_t count = _hrCount();
+  if (count < __HRLastCount)
+    __HRWraps++;
+  __HRLastCount = count;
+  uint64_t extended = ((uint64_t)__HRWraps << 32) | count;
+  __sCriticalRegionEnd();
+  return extended;
+}
+
+__STATIC_FORCEINLINE__ sUBaseType_t _hrNowUs(void)
+{
+  // a 32-bit count divided by the counts per microsecond would wrap at 2^32 / countsPerUs
+  return (sUBaseType_t)(_hrExtendedCount() / __HRCountsPerUs);
+}
+
+__STATIC_FORCEINLINE__ void _hrHardwareInit(sUBaseType_t timerClockHz)
+{
+  __HRCountsPerUs = timerClockHz / 1000000u;
+  TIMER0_CTRL = 0;
+  TIMER0_RELOAD = 0xFFFFFFFFu;
+  TIMER0_VALUE = 0xFFFFFFFFu;
+  TIMER0_INTCLEAR = 1;
+  __HRWraps = 0;
+  __HRLastCount = 0;
+  TIMER0_CTRL = TIMER_CTRL_EN | TIMER_CTRL_IRQEN;
+  NVIC_ISER[__sHRTIMER_WRAP_IRQn / 32] = 1u << (__sHRTIMER_WRAP_IRQn % 32);
+  TIMER1_CTRL = 0;
+  TIMER1_INTCLEAR = 1;
+}
+
+void TIMER0_Handler(void)
+{
+  TIMER0_INTCLEAR = 1;
+  (void)_hrExtendedCount();
+}
+
+__STATIC_FORCEINLINE__ void _hrArm(sUBaseType_t expiry)
+{
+  sUBaseType_t distance = expiry - _hrCount();
+  TIMER1_CTRL = 0;
+  TIMER1_RELOAD = 0xFFFFFFFFu;
+  TIMER1_VALUE = (distance == 0) ? 1 : distance;
+  TIMER1_CTRL = TIMER_CTRL_EN | TIMER_CTRL_IRQEN;
+}
+
+__STATIC_FORCEINLINE__ void _hrDisarm(void)
+{
+  TIMER1_CTRL = 0;
+}
+
+__STATIC_FORCEINLINE__ void _hrAcknowledge(void)
+{
+  TIMER1_INTCLEAR = 1;
+}
+
+#elif __sHRTIMER_PORT == __sHRTIMER_PORT_STM32_TIM2
+/*
+ * TIM2 is a 32-bit up counter, prescaled to count microseconds.
+ * CCR1 holds the next expiry.
+ */
+#define RCC_APB1ENR (*((volatile uint32_t *)0x40023840))
+#define TIM2_CR1 (*((volatile uint32_t *)0x40000000))
+#define TIM2_DIER (*((volatile uint32_t *)0x4000000C))
+#define TIM2_SR (*((volatile uint32_t *)0x40000010))
+#define TIM2_EGR (*((volatile uint32_t *)0x40000014))
+#define TIM2_CNT (*((volatile uint32_t *)0x40000024))
+#define TIM2_PSC (*((volatile uint32_t *)0x40000028))
+#define TIM2_ARR (*((volatile uint32_t *)0x4000002C))
+#define TIM2_CCR1 (*((volatile uint32_t *)0x40000034))
+
+#define TIM_CR1_CEN (1u << 0)
+#define TIM_DIER_CC1IE (1u << 1)
+#define TIM_SR_CC1IF (1u << 1)
+#define TIM_EGR_UG (1u << 0)
+
+#define HRTIMER_IRQHandler TIM2_IRQHandler
+
+static const sUBaseType_t __HRCountsPerUs = 1;
+
+__STATIC_FORCEINLINE__ sUBaseType_t _hrCount(void)
+{
+  return TIM2_CNT;
+}
+
+__STATIC_FORCEINLINE__ sUBaseType_t _hrNowUs(void)
+{
+  return TIM2_CNT; // already wraps at 2^32 microseconds
+}
+
+__STATIC_FORCEINLINE__ void _hrHardwareInit(sUBaseType_t timerClockHz)
+{
+  RCC_APB1ENR |= 1u;                   // TIM2 clock
+  TIM2_CR1 = 0;
+  TIM2_PSC = (timerClockHz / 1000000u) - 1; // 1 count per microsecond
+  TIM2_ARR = 0xFFFFFFFFu;
+  TIM2_EGR = TIM_EGR_UG; // load the prescaler
+  TIM2_SR = 0;
+  TIM2_DIER = 0;
+  TIM2_CR1 = TIM_CR1_CEN;
+}
+
+__STATIC_FORCEINLINE__ void _hrArm(sUBaseType_t expiry)
+{
+  TIM2_CCR1 = expiry;
+  TIM2_DIER = TIM_DIER_CC1IE;
+}
+
+__STATIC_FORCEINLINE__ void _hrDisarm(void)
+{
+  TIM2_DIER = 0;
+}
+
+__STATIC_FORCEINLINE__ void _hrAcknowledge(void)
+{
+  TIM2_SR = ~TIM_SR_CC1IF;
+}
+
+#else
+#error "unknown __sHRTIMER_PORT"
+#endif
+
+#define HRTIMER_MAX_COUNTS 0x7FFFFFFFu
+
+static sHRTimer_t *__HRTimerList = NULL; // armed timers, ordered by expiry
+
+// the counter wraps around, an expiry is reached when it is not in the future (signed distance)
+__STATIC_FORCEINLINE__ sbool_t _hrIsExpired(sUBaseType_t expiry, sUBaseType_t now)
+{
+  return (sbool_t)((sBaseType_t)(expiry - now) <= 0);
+}
+
+// programs the compare, if the expiry is already reached the interrupt is set pending by software
+// because the hardware would only match it after the counter wraps around
+static void _hrArmChecked(sUBaseType_t expiry)
+{
+  _hrArm(expiry);
+  if (_hrIsExpired(expiry, _hrCount()))
+    NVIC_ISPR[__sHRTIMER_IRQn / 32] = 1u << (__sHRTIMER_IRQn % 32);
+}
+
+sRTOS_StatusTypeDef sRTOSHRTimerInit(sUBaseType_t timerClockHz)
+{
+  if (timerClockHz < 1000000u)
+    return sRTOS_ERROR;
+
+  _hrHardwareInit(timerClockHz);
+  NVIC_ISER[__sHRTIMER_IRQn / 32] = 1u << (__sHRTIMER_IRQn % 32);
+  return sRTOS_OK;
+}
+
+sUBaseType_t sRTOSHRTimerNow(void)
+{
+  return _hrNowUs();
+}
+
+// note: must be called inside a critical region
+static void _hrUnlink(sHRTimer_t *timerHandle)
+{
+  sHRTimer_t **link = &__HRTimerList;
+  while (*link != NULL && *link != timerHandle)
+  {
+    link = &(*link)->next;
+  }
+
+  if (*link != NULL)
+    *link = timerHandle->next;
+  timerHandle->armed = sFalse;
+}
+
+void sRTOSHRTimerStart(sHRTimer_t *timerHandle, sUBaseType_t delay_us, sHRTimerFunc_t callback, void *arg)
+{
+  __sCriticalRegionBegin();
+  if (timerHandle->armed)
+    _hrUnlink(timerHandle);
+
+  // expiries are compared by signed distance, so a delay is clamped below half the counter range
+  if (delay_us > HRTIMER_MAX_COUNTS / __HRCountsPerUs)
+    delay_us = HRTIMER_MAX_COUNTS / __HRCountsPerUs;
+
+  sUBaseType_t now = _hrCount();
+  timerHandle->callback = callback;
+  timerHandle->arg = arg;
+  timerHandle->expiry = now + delay_us * __HRCountsPerUs;
+  timerHandle->armed = sTrue;
+
+  // ordered by signed distance from now: the list stays correct across a counter wrap around
+  // and timers that already expired (not yet run by the interrupt) stay in front
+  sHRTimer_t **link = &__HRTimerList;
+  while (*link != NULL && (sBaseType_t)((*link)->expiry - now) <= (sBaseType_t)(timerHandle->expiry - now))
+  {
+    link = &(*link)->next;
+  }
+  timerHandle->next = *link;
+  *link = timerHandle;
+
+  if (__HRTimerList == timerHandle)
+    _hrArmChecked(timerHandle->expiry); // new earliest expiry
+  __sCriticalRegionEnd();
+}
+
+void sRTOSHRTimerCancel(sHRTimer_t *timerHandle)
+{
+  __sCriticalRegionBegin();
+  if (timerHandle->armed)
+  {
+    _hrUnlink(timerHandle);
+    if (__HRTimerList == NULL)
+      _hrDisarm();
+    else
+      _hrArmChecked(__HRTimerList->expiry);
+  }
+  __sCriticalRegionEnd();
+}
+
+void HRTIMER_IRQHandler(void)
+{
+  _hrAcknowledge();
+
+  for (;;)
+  {
+    __sCriticalRegionBegin();
+    sHRTimer_t *timerHandle = __HRTimerList;
+    if (timerHandle == NULL)
+    {
+      _hrDisarm();
+      __sCriticalRegionEnd();
+      return;
+    }
+
+    if (!_hrIsExpired(timerHandle->expiry, _hrCount()))
+    {
+      _hrArm(timerHandle->expiry);
+      // the expiry may have been reached while the compare was programmed
+      if (!_hrIsExpired(timerHandle->expiry, _hrCount()))
+      {
+        __sCriticalRegionEnd();
+        return;
+      }
+    }
+
+    __HRTimerList = timerHandle->next;
+    timerHandle->armed = sFalse;
+    __sCriticalRegionEnd();
+
+    timerHandle->callback(timerHandle->arg);
+  }
+}
+
+#endif
@@ -7,18 +7,29 @@
 
 #include "simpleRTOS.h"
 
-volatile sUBaseType_t _sTickCount = 0;
+volatile sTick_t _sTickCount = 0; // incremented by SysTick, low word first
 volatile sUBaseType_t _sIsTimerRunning = 0;
+volatile sUBaseType_t _sCriticalNesting = 0; // depth of the critical regions, BASEPRI is cleared when it reaches 0
+#if defined(__ARM_ARCH_6M__)
+volatile sUBaseType_t _sExclusivePrimask = 0; // interrupt mask saved by __sLoadExclusive
+#endif
 
 extern void sScheduler_Handler(void);
 extern void sTimerReturn_Handler(void);
 
-sUBaseType_t sGetTick()
+sTick_t sGetTick()
 {
-  __sCriticalRegionBegin();
-  sUBaseType_t temp = _sTickCount;
-  __sCriticalRegionEnd();
-  return temp;
+  // SysTick can update the count between the two word reads,
+  // if the high word has changed the read is retried
+  volatile sUBaseType_t *tick = (volatile sUBaseType_t *)&_sTickCount;
+  sUBaseType_t high, low;
+  do
+  {
+    high = tick[1];
+    low = tick[0];
+  } while (high != tick[1]);
+
+  return ((sTick_t)high << 32) | low;
 }
 
 __attribute__((weak)) void SysTick_Handler(void) {}
@@ -0,0 +1,330 @@
+/*
+ * simpleRTOSHeap.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: brachiGH
+ */
+
+#include "simpleRTOS.h"
+#include "stdlib.h"
+
+#if __sUSE_KERNEL_HEAP == 1
+
+/*
+ * Two-level segregated fit (TLSF) allocator.
+ * Free blocks are kept in FL_INDEX_COUNT x SL_INDEX_COUNT lists: the first level is the
+ * power of two of the size, the second level splits it in SL_INDEX_COUNT linear ranges.
+ * Two bitmaps tell which lists are not empty, so finding a fitting block is a couple of
+ * clz/ctz, and freeing merges with the physical neighbours in constant time.
+ */
+#define ALIGN_SIZE_LOG2 3
+#define ALIGN_SIZE (1u << ALIGN_SIZE_LOG2) // payloads are 8 bytes aligned (AAPCS stacks)
+#define SL_INDEX_COUNT_LOG2 4
+#define SL_INDEX_COUNT (1u << SL_INDEX_COUNT_LOG2)
+#define FL_INDEX_MAX 20 // blocks up to 1MB
+#define FL_INDEX_SHIFT (SL_INDEX_COUNT_LOG2 + ALIGN_SIZE_LOG2)
+#define FL_INDEX_COUNT (FL_INDEX_MAX - FL_INDEX_SHIFT + 1)
+#define SMALL_BLOCK_SIZE (1u << FL_INDEX_SHIFT)
+
+#define BLOCK_FREE 0x1u
+#define BLOCK_SIZE_MASK (~(ALIGN_SIZE - 1))
+
+typedef struct sHeapBlock
+{
+  struct sHeapBlock *prevPhys; // previous block in memory, NULL for the first block of a region
+  sUBaseType_t size;           // payload size in bytes, bit 0 is set if the block is free
+  struct sHeapBlock *nextFree; // free list links, only valid while the block is free
+  struct sHeapBlock *prevFree; // (they are the first bytes of the payload of a used block)
+} sHeapBlock_t;
+
+#define BLOCK_HEADER_SIZE (offsetof(sHeapBlock_t, nextFree))
+#define BLOCK_SIZE_MIN (sizeof(sHeapBlock_t) - BLOCK_HEADER_SIZE)
+#define BLOCK_SIZE_MAX (1u << FL_INDEX_MAX)
+
+static sUBaseType_t __HeapFlBitmap = 0;
+static sUBaseType_t __HeapSlBitmap[FL_INDEX_COUNT] = {0};
+static sHeapBlock_t *__HeapFreeLists[FL_INDEX_COUNT][SL_INDEX_COUNT] = {{NULL}};
+
+static sUBaseType_t __HeapTotalBytes = 0;
+static sUBaseType_t __HeapFreeBytes = 0;
+static sUBaseType_t __HeapMinimumEverFreeBytes = 0;
+static sUBaseType_t __HeapAllocations = 0;
+static sUBaseType_t __HeapFailedAllocations = 0;
+
+#if __sKERNEL_HEAP_SIZE > 0
+static uint8_t __HeapRegion[__sKERNEL_HEAP_SIZE] __attribute__((aligned(ALIGN_SIZE)));
+static sbool_t __HeapRegionAdded = sFalse;
+#endif
+
+__STATIC_FORCEINLINE__ sUBaseType_t _blockSize(sHeapBlock_t *block)
+{
+  return block->size & BLOCK_SIZE_MASK;
+}
+
+__STATIC_FORCEINLINE__ sHeapBlock_t *_blockNext(sHeapBlock_t *block)
+{
+  return (sHeapBlock_t *)((uint8_t *)block + BLOCK_HEADER_SIZE + _blockSize(block));
+}
+
+static void _mappingInsert(sUBaseType_t size, sUBaseType_t *fl, sUBaseType_t *sl)
+{
+  if (size < SMALL_BLOCK_SIZE)
+  {
+    *fl = 0;
+    *sl = size / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT);
+  }
+  else
+  {
+    sUBaseType_t f = __sHighestBit(size);
+    *sl = (size >> (f - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+    *fl = f - (FL_INDEX_SHIFT - 1);
+  }
+}
+
+// rounds size up to the next list, so every block of that list is large enough
+static void _mappingSearch(sUBaseType_t size, sUBaseType_t *fl, sUBaseType_t *sl)
+{
+  if (size >= SMALL_BLOCK_SIZE)
+    size += (1u << (__sHighestBit(size) - SL_INDEX_COUNT_LOG2)) - 1;
+  _mappingInsert(size, fl, sl);
+}
+
+static sHeapBlock_t *_findFreeBlock(sUBaseType_t *fl, sUBaseType_t *sl)
+{
+  if (*fl >= FL_INDEX_COUNT)
+    return NULL;
+
+  sUBaseType_t slMap = __HeapSlBitmap[*fl] & (~0u << *sl);
+  if (slMap == 0)
+  {
+    // no block in this first level, take the smallest larger first level
+    sUBaseType_t flMap = __HeapFlBitmap & (~0u << (*fl + 1));
+    if (flMap == 0)
+      return NULL;
+
+    *fl = __sLowestBit(flMap);
+    slMap = __HeapSlBitmap[*fl];
+  }
+  *sl = __sLowestBit(slMap);
+  return __HeapFreeLists[*fl][*sl];
+}
+
+static void _removeFreeBlock(sHeapBlock_t *block, sUBaseType_t fl, sUBaseType_t sl)
+{
+  sHeapBlock_t *prev = block->prevFree;
+  sHeapBlock_t *next = block->nextFree;
+  if (next != NULL)
+    next->prevFree = prev;
+  if (prev != NULL)
+    prev->nextFree = next;
+
+  if (__HeapFreeLists[fl][sl] == block)
+  {
+    __HeapFreeLists[fl][sl] = next;
+    if (next == NULL)
+    {
+      __HeapSlBitmap[fl] &= ~(1u << sl);
+      if (__HeapSlBitmap[fl] == 0)
+        __HeapFlBitmap &= ~(1u << fl);
+    }
+  }
+  block->size &= ~BLOCK_FREE;
+  __HeapFreeBytes -= _blockSize(block);
+}
+
+static void _unlinkFreeBlock(sHeapBlock_t *block)
+{
+  sUBaseType_t fl, sl;
+  _mappingInsert(_blockSize(block), &fl, &sl);
+  _removeFreeBlock(block, fl, sl);
+}
+
+static void _insertFreeBlock(sHeapBlock_t *block)
+{
+  sUBaseType_t fl, sl;
+  _mappingInsert(_blockSize(block), &fl, &sl);
+
+  sHeapBlock_t *head = __HeapFreeLists[fl][sl];
+  block->nextFree = head;
+  block->prevFree = NULL;
+  if (head != NULL)
+    head->prevFree = block;
+  __HeapFreeLists[fl][sl] = block;
+  __HeapFlBitmap |= 1u << fl;
+  __HeapSlBitmap[fl] |= 1u << sl;
+
+  block->size |= BLOCK_FREE;
+  __HeapFreeBytes += _blockSize(block);
+}
+
+sRTOS_StatusTypeDef sRTOSHeapAddRegion(void *start, sUBaseType_t size)
+{
+  uintptr_t first = ((uintptr_t)start + ALIGN_SIZE - 1) & ~(uintptr_t)(ALIGN_SIZE - 1);
+  uintptr_t end = ((uintptr_t)start + size) & ~(uintptr_t)(ALIGN_SIZE - 1);
+
+  // one free block and the used sentinel block that ends the region
+  if (end <= first || end - first < 2 * BLOCK_HEADER_SIZE + BLOCK_SIZE_MIN)
+    return sRTOS_ERROR;
+
+  sUBaseType_t payload = (sUBaseType_t)(end - first) - 2 * BLOCK_HEADER_SIZE;
+  if (payload >= BLOCK_SIZE_MAX)
+    payload = BLOCK_SIZE_MAX - ALIGN_SIZE; // the rest of the region is not used
+
+  sHeapBlock_t *block = (sHeapBlock_t *)first;
+  block->prevPhys = NULL;
+  block->size = payload;
+
+  sHeapBlock_t *sentinel = _blockNext(block);
+  sentinel->prevPhys = block;
+  sentinel->size = 0;
+
+  __sCriticalRegionBegin();
+  _insertFreeBlock(block);
+  __HeapTotalBytes += payload;
+  __HeapMinimumEverFreeBytes += payload;
+  __sCriticalRegionEnd();
+  return sRTOS_OK;
+}
+
+void *sRTOSMalloc(sUBaseType_t size)
+{
+#if __sKERNEL_HEAP_SIZE > 0
+  if (!__HeapRegionAdded)
+  {
+    __sCriticalRegionBegin(); // critical regions nest, sRTOSHeapAddRegion enters it again
+    if (!__HeapRegionAdded)
+    {
+      __HeapRegionAdded = sTrue;
+      sRTOSHeapAddRegion(__HeapRegion, sizeof(__HeapRegion));
+    }
+    __sCriticalRegionEnd();
+  }
+#endif
+
+  if (size == 0 || size >= BLOCK_SIZE_MAX)
+    return NULL;
+
+  size = (size + ALIGN_SIZE - 1) & BLOCK_SIZE_MASK;
+  if (size < BLOCK_SIZE_MIN)
+    size = BLOCK_SIZE_MIN;
+
+  sUBaseType_t fl, sl;
+  _mappingSearch(size, &fl, &sl);
+
+  __sCriticalRegionBegin();
+  sHeapBlock_t *block = _findFreeBlock(&fl, &sl);
+  if (block == NULL)
+  {
+    __HeapFailedAllocations++;
+    __sCriticalRegionEnd();
+    return NULL;
+  }
+  _removeFreeBlock(block, fl, sl);
+
+  // the end of the block goes back to the free lists if it can hold a block
+  if (_blockSize(block) >= size + BLOCK_HEADER_SIZE + BLOCK_SIZE_MIN)
+  {
+    sHeapBlock_t *remaining = (sHeapBlock_t *)((uint8_t *)block + BLOCK_HEADER_SIZE + size);
+    remaining->prevPhys = block;
+    remaining->size = _blockSize(block) - size - BLOCK_HEADER_SIZE;
+    block->size = size;
+    _blockNext(remaining)->prevPhys = remaining;
+    _insertFreeBlock(remaining);
+  }
+
+  __HeapAllocations++;
+  if (__HeapFreeBytes < __HeapMinimumEverFreeBytes)
+    __HeapMinimumEverFreeBytes = __HeapFreeBytes;
+  __sCriticalRegionEnd();
+
+  return (uint8_t *)block + BLOCK_HEADER_SIZE;
+}
+
+void sRTOSFree(void *ptr)
+{
+  if (ptr == NULL)
+    return;
+
+  sHeapBlock_t *block = (sHeapBlock_t *)((uint8_t *)ptr - BLOCK_HEADER_SIZE);
+
+  __sCriticalRegionBegin();
+  sHeapBlock_t *prev = block->prevPhys;
+  if (prev != NULL && (prev->size & BLOCK_FREE))
+  {
+    _unlinkFreeBlock(prev);
+    prev->size += BLOCK_HEADER_SIZE + _blockSize(block);
+    block = prev;
+  }
+
+  sHeapBlock_t *next = _blockNext(block);
+  if (next->size & BLOCK_FREE)
+  {
+    _unlinkFreeBlock(next);
+    block->size += BLOCK_HEADER_SIZE + _blockSize(next);
+  }
+  _blockNext(block)->prevPhys = block;
+
+  _insertFreeBlock(block);
+  __sCriticalRegionEnd();
+}
+
+void sRTOSHeapGetStats(sHeapStats_t *stats)
+{
+  __sCriticalRegionBegin();
+  stats->totalBytes = __HeapTotalBytes;
+  stats->freeBytes = __HeapFreeBytes;
+  stats->minimumEverFreeBytes = __HeapMinimumEverFreeBytes;
+  stats->allocations = __HeapAllocations;
+  stats->failedAllocations = __HeapFailedAllocations;
+
+  // the largest block is in the highest non empty list, only that list is walked
+  stats->largestFreeBlock = 0;
+  if (__HeapFlBitmap != 0)
+  {
+    sUBaseType_t fl = __sHighestBit(__HeapFlBitmap);
+    sUBaseType_t sl = __sHighestBit(__HeapSlBitmap[fl]);
+    for (sHeapBlock_t *block = __HeapFreeLists[fl][sl]; block != NULL; block = block->nextFree)
+    {
+      if (_blockSize(block) > stats->largestFreeBlock)
+        stats->largestFreeBlock = _blockSize(block);
+    }
+  }
+  __sCriticalRegionEnd();
+
+  // share of the free memory that is not in the largest block, in per mille
+  stats->fragmentation = (stats->freeBytes == 0)
+                             ? 0
+                             : 1000u - (sUBaseType_t)(((uint64_t)stats->largestFreeBlock * 1000u) / stats->freeBytes);
+}
+
+#else
+
+void *sRTOSMalloc(sUBaseType_t size)
+{
+  return malloc(size);
+}
+
+void sRTOSFree(void *ptr)
+{
+  free(ptr);
+}
+
+sRTOS_StatusTypeDef sRTOSHeapAddRegion(void *start, sUBaseType_t size)
+{
+  (void)start;
+  (void)size;
+  return sRTOS_ERROR; // the C library heap is used
+}
+
+void sRTOSHeapGetStats(sHeapStats_t *stats)
+{
+  stats->totalBytes = 0;
+  stats->freeBytes = 0;
+  stats->minimumEverFreeBytes = 0;
+  stats->largestFreeBlock = 0;
+  stats->allocations = 0;
+  stats->failedAllocations = 0;
+  stats->fragmentation = 0;
+}
+
+#endif
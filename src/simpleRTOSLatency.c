@@ -0,0 +1,212 @@
+/*
+ * simpleRTOSLatency.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: brachiGH
+ */
+
+#include "simpleRTOS.h"
+#include "string.h"
+
+#if __sUSE_LATENCY_STATS == 1 || __sUSE_CRITICAL_STATS == 1
+
+#if __sLATENCY_CLOCK == __sLATENCY_CLOCK_DWT
+#if defined(__ARM_ARCH_6M__)
+#error "ARMv6-M has no DWT cycle counter, use __sLATENCY_CLOCK_CMSDK"
+#endif
+#define DEMCR (*((volatile uint32_t *)0xE000EDFC))
+#define DWT_CTRL (*((volatile uint32_t *)0xE0001000))
+#define DWT_CYCCNT (*((volatile uint32_t *)0xE0001004))
+
+#define DEMCR_TRCENA (1u << 24)
+#define DWT_CTRL_CYCCNTENA (1u << 0)
+
+__STATIC_FORCEINLINE__ sUBaseType_t __latencyNow(void)
+{
+  return DWT_CYCCNT;
+}
+
+void _sLatencyClockInit(void)
+{
+  DEMCR |= DEMCR_TRCENA; // enables the DWT
+  DWT_CYCCNT = 0;
+  DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+#elif __sLATENCY_CLOCK == __sLATENCY_CLOCK_CMSDK
+// same free running down counter as the CMSDK high-resolution timer port
+#define TIMER0_CTRL (*((volatile uint32_t *)0x40000000))
+#define TIMER0_VALUE (*((volatile uint32_t *)0x40000004))
+#define TIMER0_RELOAD (*((volatile uint32_t *)0x40000008))
+
+#define TIMER_CTRL_EN (1u << 0)
+
+__STATIC_FORCEINLINE__ sUBaseType_t __latencyNow(void)
+{
+  return 0xFFFFFFFFu - TIMER0_VALUE;
+}
+
+void _sLatencyClockInit(void)
+{
+  if (TIMER0_CTRL & TIMER_CTRL_EN)
+    return; // already started by sRTOSHRTimerInit
+
+  TIMER0_RELOAD = 0xFFFFFFFFu;
+  TIMER0_VALUE = 0xFFFFFFFFu;
+  TIMER0_CTRL = TIMER_CTRL_EN;
+}
+
+#else
+#error "unknown __sLATENCY_CLOCK"
+#endif
+
+#endif
+
+#if __sUSE_LATENCY_STATS == 1
+
+static void __recordLatency(sLatencyHistogram_t *histogram, sUBaseType_t latency)
+{
+  sUBaseType_t bucket = (latency == 0) ? 0 : __sHighestBit(latency);
+  if (bucket >= __sLATENCY_BUCKETS)
+    bucket = __sLATENCY_BUCKETS - 1;
+
+  histogram->bucket[bucket]++;
+  histogram->samples++;
+  if (latency > histogram->max)
+    histogram->max = latency;
+}
+
+// the task became ready (note: must be called inside a critical region)
+void _sLatencyReady(sTaskHandle_t *task)
+{
+  if (task->latencyPending)
+    return; // it is already waiting to run, the latency counts from the first ready transition
+
+  sUBaseType_t ipsr;
+  __asm volatile("mrs %0, ipsr" : "=r"(ipsr));
+
+  task->readyStamp = __latencyNow();
+  task->latencyFromISR = (sbool_t)(ipsr >= 16); // exception numbers 16 and above are the peripheral interrupts
+  task->latencyPending = sTrue;
+}
+
+// the task is switched in by the scheduler
+void _sLatencySwitchIn(sTaskHandle_t *task)
+{
+  if (!task->latencyPending)
+    return;
+
+  sUBaseType_t latency = __latencyNow() - task->readyStamp;
+  __recordLatency(task->latencyFromISR ? &task->latency.isrToTask : &task->latency.wakeup, latency);
+  task->latencyPending = sFalse;
+}
+
+void sRTOSLatencyGetStats(sTaskHandle_t *task, sLatencyStats_t *stats)
+{
+  __sCriticalRegionBegin();
+  *stats = task->latency;
+  __sCriticalRegionEnd();
+}
+
+void sRTOSLatencyReset(sTaskHandle_t *task)
+{
+  __sCriticalRegionBegin();
+  memset(&task->latency, 0, sizeof(sLatencyStats_t));
+  __sCriticalRegionEnd();
+}
+
+#endif
+
+#if __sUSE_CRITICAL_STATS == 1
+
+static sCriticalStats_t __CriticalStats = {0};
+static sUBaseType_t __CriticalStart;
+static const char *__CriticalFile;
+static sUBaseType_t __CriticalLine;
+
+// called by the outermost __sCriticalRegionBegin, the interrupts are already masked
+void _sCriticalStatsBegin(const char *file, sUBaseType_t line)
+{
+  __CriticalFile = file;
+  __CriticalLine = line;
+  __CriticalStart = __latencyNow();
+}
+
+// called by the outermost __sCriticalRegionEnd, before the interrupts are unmasked
+void _sCriticalStatsEnd(void)
+{
+  sUBaseType_t duration = __latencyNow() - __CriticalStart;
+  const char *file = __CriticalFile;
+  sUBaseType_t line = __CriticalLine;
+
+  __CriticalFile = NULL;
+  if (file == NULL)
+    return; // no call site recorded (the kernel handlers set the nesting without __sCriticalRegionBegin)
+
+  __CriticalStats.regions++;
+  if (duration > __CriticalStats.worst.max)
+  {
+    __CriticalStats.worst.file = file;
+    __CriticalStats.worst.line = line;
+    __CriticalStats.worst.max = duration;
+  }
+
+  // the call site keeps its slot, else it replaces the slot with the shortest worst case if it is longer
+  sCriticalSite_t *slot = NULL;
+  sCriticalSite_t *shortest = &__CriticalStats.top[0];
+  for (sUBaseType_t i = 0; i < __sCRITICAL_STATS_TOP; i++)
+  {
+    sCriticalSite_t *site = &__CriticalStats.top[i];
+    if (site->file == file && site->line == line)
+    {
+      slot = site;
+      break;
+    }
+    if (site->max < shortest->max)
+      shortest = site;
+  }
+
+  if (slot == NULL)
+  {
+    if (shortest->file != NULL && duration <= shortest->max)
+      return;
+    slot = shortest;
+    slot->file = file;
+    slot->line = line;
+    slot->max = 0;
+    slot->count = 0;
+  }
+
+  slot->count++;
+  if (duration > slot->max)
+    slot->max = duration;
+}
+
+void sRTOSCriticalGetStats(sCriticalStats_t *stats)
+{
+  __sCriticalRegionBegin();
+  *stats = __CriticalStats;
+  __sCriticalRegionEnd();
+
+  // the table is kept unsorted, the copy is sorted outside of the critical region
+  for (sUBaseType_t i = 1; i < __sCRITICAL_STATS_TOP; i++)
+  {
+    sCriticalSite_t site = stats->top[i];
+    sUBaseType_t j = i;
+    while (j > 0 && stats->top[j - 1].max < site.max)
+    {
+      stats->top[j] = stats->top[j - 1];
+      j--;
+    }
+    stats->top[j] = site;
+  }
+}
+
+void sRTOSCriticalResetStats(void)
+{
+  __sCriticalRegionBegin();
+  memset(&__CriticalStats, 0, sizeof(sCriticalStats_t));
+  __sCriticalRegionEnd();
+}
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ * simpleRTOSObjectStats.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: brachiGH
+ */
+
+#include "simpleRTOS.h"
+#include "string.h"
+
+#if __sUSE_OBJECT_STATS == 1
+
+/*
+ * Every semaphore, mutex and queue carries its own counters, updated by the kernel
+ * whether the object is registered or not. The registry only maps names to objects so
+ * that a monitor task or a debugger can walk them: it stores pointers, the names are
+ * not copied and the objects must outlive their entry.
+ */
+typedef struct
+{
+  void *object;
+  sObjectType_t type;
+  const char *name;
+} __sObjectEntry_t;
+
+static __sObjectEntry_t __ObjectRegistry[__sMAX_NAMED_OBJECTS];
+static sUBaseType_t __ObjectCount = 0;
+
+static sObjectStats_t *__objectStats(void *object, sObjectType_t type)
+{
+  switch (type)
+  {
+  case sObjectSemaphore:
+    return &((sSemaphore_t *)object)->stats;
+  case sObjectMutex:
+    return &((sMutex_t *)object)->stats;
+  case sObjectQueue:
+    return &((sQueueHandle_t *)object)->stats;
+  default:
+    return NULL;
+  }
+}
+
+// counts a successful take, send or receive.
+// note: lock-free, it may be called from the fast paths outside of any critical region
+void _sObjectStatsAcquire(sObjectStats_t *stats)
+{
+  sUBaseType_t value;
+  do
+  {
+    value = __sLoadExclusive(&stats->acquisitions);
+  } while (__sStoreExclusive(&stats->acquisitions, value + 1));
+}
+
+// a task blocked on the object from tick start until now, acquired is sFalse if it gave up
+void _sObjectStatsWait(sObjectStats_t *stats, sTick_t start, sbool_t acquired)
+{
+  sTick_t waited = sGetTick() - start;
+
+  __sCriticalRegionBegin();
+  stats->contended++;
+  stats->totalWaitTicks += waited;
+  if (waited > stats->maxWaitTicks)
+    stats->maxWaitTicks = waited;
+  if (!acquired)
+    stats->timeouts++;
+  __sCriticalRegionEnd();
+}
+
+sRTOS_StatusTypeDef sRTOSObjectRegister(void *object, sObjectType_t type, const char *name)
+{
+  if (object == NULL || __objectStats(object, type) == NULL)
+    return sRTOS_ERROR;
+
+  __sCriticalRegionBegin();
+  for (sUBaseType_t i = 0; i < __ObjectCount; i++)
+  {
+    if (__ObjectRegistry[i].object == object) // registered again: renamed
+    {
+      __ObjectRegistry[i].type = type;
+      __ObjectRegistry[i].name = name;
+      __sCriticalRegionEnd();
+      return sRTOS_OK;
+    }
+  }
+
+  if (__ObjectCount == __sMAX_NAMED_OBJECTS)
+  {
+    __sCriticalRegionEnd();
+    return sRTOS_ERROR;
+  }
+
+  __ObjectRegistry[__ObjectCount].object = object;
+  __ObjectRegistry[__ObjectCount].type = type;
+  __ObjectRegistry[__ObjectCount].name = name;
+  __ObjectCount++;
+  __sCriticalRegionEnd();
+  return sRTOS_OK;
+}
+
+void sRTOSObjectUnregister(void *object)
+{
+  __sCriticalRegionBegin();
+  for (sUBaseType_t i = 0; i < __ObjectCount; i++)
+  {
+    if (__ObjectRegistry[i].object == object)
+    {
+      // keeps the registration order of the other entries
+      memmove(&__ObjectRegistry[i], &__ObjectRegistry[i + 1], (__ObjectCount - i - 1) * sizeof(__sObjectEntry_t));
+      __ObjectCount--;
+      break;
+    }
+  }
+  __sCriticalRegionEnd();
+}
+
+sbool_t sRTOSObjectGetInfo(sUBaseType_t index, sObjectInfo_t *info)
+{
+  __sCriticalRegionBegin();
+  if (index >= __ObjectCount)
+  {
+    __sCriticalRegionEnd();
+    return sFalse;
+  }
+
+  info->object = __ObjectRegistry[index].object;
+  info->type = __ObjectRegistry[index].type;
+  info->name = __ObjectRegistry[index].name;
+  info->stats = *__objectStats(info->object, info->type);
+  __sCriticalRegionEnd();
+  return sTrue;
+}
+
+void sRTOSObjectGetStats(void *object, sObjectType_t type, sObjectStats_t *stats)
+{
+  __sCriticalRegionBegin();
+  *stats = *__objectStats(object, type);
+  __sCriticalRegionEnd();
+}
+
+void sRTOSObjectResetStats(void *object, sObjectType_t type)
+{
+  __sCriticalRegionBegin();
+  sObjectStats_t *stats = __objectStats(object, type);
+  memset(stats, 0, sizeof(sObjectStats_t));
+  if (type == sObjectQueue)
+    stats->highWater = ((sQueueHandle_t *)object)->lenght; // the level now is the new baseline
+  __sCriticalRegionEnd();
+}
+
+#endif
@@ -9,90 +9,245 @@
 #include "stdlib.h"
 #include "string.h"
 
+extern sbool_t _sBlockCurrentTask(sUBaseType_t timeoutTicks);
+extern void _sWakeTask(sTaskHandle_t *task);
+extern void _sWaitListAppend(sTaskHandle_t **list, sTaskHandle_t *task);
+extern void _sWaitListRemove(sTaskHandle_t **list, sTaskHandle_t *task);
+#if __sUSE_OBJECT_STATS == 1
+extern void _sObjectStatsAcquire(sObjectStats_t *stats);
+extern void _sObjectStatsWait(sObjectStats_t *stats, sTick_t start, sbool_t acquired);
+#endif
+
 extern sTaskHandle_t *_sCurrentTask;
 
-void sRTOSQueueCreate(sQueueHandle_t *queueHandle, sUBaseType_t queueLengh, sUBaseType_t itemSize)
+/*
+ * A task that finds the queue empty blocks in the receive wait list, one that finds it
+ * full in the send wait list. Both can hold tasks at the same time (a receiver woken by
+ * a send has not run yet when the next send finds the queue full), so every send wakes
+ * the oldest receiver and every receive the oldest sender. The woken task tries again
+ * when it runs (with what is left of its timeout): a task that ran in between may have
+ * taken the item or the slot.
+ *
+ * Stopped waiters keep their place and are skipped (they try again when resumed). A woken
+ * task that is stopped or deleted before it runs passes its wakeup to the next waiter, so
+ * an item or a slot is never left behind while other tasks sleep.
+ */
+
+void sRTOSQueueCreateStatic(sQueueHandle_t *queueHandle, sUBaseType_t queueLengh, sUBaseType_t itemSize, uint8_t *storage)
 {
   queueHandle->maxLenght = queueLengh;
   queueHandle->lenght = 0;
   queueHandle->itemSize = itemSize;
-  queueHandle->index = -1;
-  queueHandle->items = malloc(queueLengh * sizeof(void *));
+  queueHandle->readIndex = 0;
+  queueHandle->storage = storage;
+  queueHandle->sendWaitList = NULL;
+  queueHandle->receiveWaitList = NULL;
+#if __sUSE_OBJECT_STATS == 1
+  memset(&queueHandle->stats, 0, sizeof(sObjectStats_t));
+#endif
 }
 
-sbool_t sRTOSQueueReceive(sQueueHandle_t *queueHandle, void *itemPtr, sUBaseType_t timeoutTicks)
+sRTOS_StatusTypeDef sRTOSQueueCreate(sQueueHandle_t *queueHandle, sUBaseType_t queueLengh, sUBaseType_t itemSize)
 {
-  sUBaseType_t timeoutFinish = SAT_ADD_U32(sGetTick(), timeoutTicks);
-  __sCriticalRegionBegin();
-  while (queueHandle->lenght == 0)
+  // one block for every item, send/receive copy in place and never allocate
+  uint8_t *storage = (uint8_t *)sRTOSMalloc(queueLengh * itemSize);
+  if (storage == NULL)
   {
-    __sCriticalRegionEnd();
-    if (timeoutFinish <= sGetTick())
-    {
-      return sFalse;
-    }
-    sRTOSTaskYield();
-    __sCriticalRegionBegin();
+    sRTOSQueueCreateStatic(queueHandle, 0, itemSize, NULL); // always full and empty, the storage is never touched
+    return sRTOS_ALLOCATION_FAILED;
   }
-  sUBaseType_t readPos = queueHandle->index % queueHandle->maxLenght;
-  void *temp = queueHandle->items[readPos];
 
-  memcpy(itemPtr, temp, queueHandle->itemSize);
-  free(temp);
+  sRTOSQueueCreateStatic(queueHandle, queueLengh, itemSize, storage);
+  return sRTOS_OK;
+}
+
+// note: must be called inside a critical region, with the queue not full
+static void _queueWrite(sQueueHandle_t *queueHandle, void *itemPtr)
+{
+  sUBaseType_t writePos = queueHandle->readIndex + queueHandle->lenght;
+  if (writePos >= queueHandle->maxLenght)
+    writePos -= queueHandle->maxLenght;
+
+  memcpy(queueHandle->storage + writePos * queueHandle->itemSize, itemPtr, queueHandle->itemSize);
+  queueHandle->lenght++;
+#if __sUSE_OBJECT_STATS == 1
+  if (queueHandle->lenght > queueHandle->stats.highWater)
+    queueHandle->stats.highWater = queueHandle->lenght;
+  _sObjectStatsAcquire(&queueHandle->stats);
+#endif
+}
+
+// note: must be called inside a critical region, with the queue not empty
+static void _queueRead(sQueueHandle_t *queueHandle, void *itemPtr)
+{
+  memcpy(itemPtr, queueHandle->storage + queueHandle->readIndex * queueHandle->itemSize, queueHandle->itemSize);
+  queueHandle->readIndex++;
+  if (queueHandle->readIndex == queueHandle->maxLenght)
+    queueHandle->readIndex = 0;
   queueHandle->lenght--;
+#if __sUSE_OBJECT_STATS == 1
+  _sObjectStatsAcquire(&queueHandle->stats);
+#endif
+}
+
+// wakes the oldest task of waitList that is not stopped,
+// returns sTrue if it has a higher priority than the current task.
+// note: must be called inside a critical region
+static sbool_t _queueWakeWaiter(sTaskHandle_t **waitList)
+{
+  sTaskHandle_t *task = *waitList;
+  while (task != NULL && task->stopped)
+  {
+    task = task->nextWaiter;
+  }
+  if (task == NULL)
+    return sFalse;
+
+  _sWaitListRemove(waitList, task);
+  task->waitList = waitList; // the list it was woken from, until it runs
+  task->waitGranted = sTrue;
+  _sWakeTask(task);
+  return (sbool_t)(task->priority > _sCurrentTask->priority);
+}
+
+// a task woken from a queue wait list is stopped or deleted before it ran: the next waiter gets the wakeup.
+// returns sTrue if that waiter has a higher priority than the current task.
+// note: must be called inside a critical region
+sbool_t _sQueuePassWakeup(sTaskHandle_t *task)
+{
+  sTaskHandle_t **waitList = task->waitList;
+  if (!task->waitGranted || waitList == NULL) // not woken, or woken by a lock (the lock clears waitList)
+    return sFalse;
+
+  task->waitGranted = sFalse;
+  task->waitList = NULL;
+  return _queueWakeWaiter(waitList);
+}
+
+// blocks the current task in waitList until it is woken or the deadline is reached,
+// returns sFalse if the deadline is reached.
+// note: must be called inside a critical region, it returns inside it
+static sbool_t _queueWait(sTaskHandle_t **waitList, sTick_t deadline)
+{
+  sTick_t now = sGetTick();
+  if (deadline <= now)
+    return sFalse;
+
+  _sWaitListAppend(waitList, _sCurrentTask);
+  _sBlockCurrentTask((deadline == sTICK_MAX) ? __sMAX_DELAY : (sUBaseType_t)(deadline - now)); // if it fails the task polls
   __sCriticalRegionEnd();
+  sRTOSTaskYield();
+  __sCriticalRegionBegin();
+  _sWaitListRemove(waitList, _sCurrentTask); // still in the list on timeout
+  _sCurrentTask->waitList = NULL;            // the wakeup is consumed
+  _sCurrentTask->waitGranted = sFalse;
   return sTrue;
 }
 
-sbool_t sRTOSQueueSend(sQueueHandle_t *queueHandle, void *itemPtr, sUBaseType_t timeoutTicks)
+// waits while the queue holds busyLenght items (0 to receive, maxLenght to send),
+// returns sFalse if it still does at the deadline.
+// note: must be called inside a critical region, it returns inside it
+static sbool_t _queueWaitWhile(sQueueHandle_t *queueHandle, sUBaseType_t busyLenght, sTick_t deadline)
 {
-  sUBaseType_t timeoutFinish = SAT_ADD_U32(sGetTick(), timeoutTicks);
-  __sCriticalRegionBegin();
-  while (queueHandle->lenght == queueHandle->maxLenght)
+  if (queueHandle->lenght != busyLenght)
+    return sTrue;
+
+#if __sUSE_OBJECT_STATS == 1
+  if (busyLenght == 0)
+    queueHandle->stats.emptyEvents++;
+  else
+    queueHandle->stats.fullEvents++;
+  sTick_t start = sGetTick();
+  sbool_t blocked = sFalse;
+#endif
+
+  sTaskHandle_t **waitList = (busyLenght == 0) ? &queueHandle->receiveWaitList : &queueHandle->sendWaitList;
+  sbool_t available = sTrue;
+  while (queueHandle->lenght == busyLenght)
   {
-    __sCriticalRegionEnd();
-    if (timeoutFinish <= sGetTick())
+    if (!_queueWait(waitList, deadline))
     {
-      return sFalse;
+      available = sFalse;
+      break;
     }
-    sRTOSTaskYield();
-    __sCriticalRegionBegin();
+#if __sUSE_OBJECT_STATS == 1
+    blocked = sTrue;
+#endif
   }
-  void *temp = malloc(queueHandle->itemSize);
-  if (temp == NULL)
+
+#if __sUSE_OBJECT_STATS == 1
+  if (blocked)
+    _sObjectStatsWait(&queueHandle->stats, start, available);
+#endif
+  return available;
+}
+
+sbool_t sRTOSQueueReceive(sQueueHandle_t *queueHandle, void *itemPtr, sUBaseType_t timeoutTicks)
+{
+  sTick_t timeoutFinish = __sTickDeadline(sGetTick(), timeoutTicks);
+  __sCriticalRegionBegin();
+  if (!_queueWaitWhile(queueHandle, 0, timeoutFinish))
   {
     __sCriticalRegionEnd();
     return sFalse;
   }
-  memcpy(temp, itemPtr, queueHandle->itemSize);
-  queueHandle->index++;
-  sUBaseType_t writePos = queueHandle->index % queueHandle->maxLenght;
-  queueHandle->items[writePos] = temp;
-  queueHandle->lenght++;
+
+  _queueRead(queueHandle, itemPtr);
+  sbool_t yield = _queueWakeWaiter(&queueHandle->sendWaitList); // a sender waiting for the slot
   __sCriticalRegionEnd();
+
+  __sYieldIfWoken(yield);
   return sTrue;
 }
 
-sbool_t sRTOSQueueSendFromISR(sQueueHandle_t *queueHandle, void *itemPtr)
+sbool_t sRTOSQueueSend(sQueueHandle_t *queueHandle, void *itemPtr, sUBaseType_t timeoutTicks)
+{
+  sTick_t timeoutFinish = __sTickDeadline(sGetTick(), timeoutTicks);
+  __sCriticalRegionBegin();
+  if (!_queueWaitWhile(queueHandle, queueHandle->maxLenght, timeoutFinish))
+  {
+    __sCriticalRegionEnd();
+    return sFalse;
+  }
+
+  _queueWrite(queueHandle, itemPtr);
+  sbool_t yield = _queueWakeWaiter(&queueHandle->receiveWaitList); // a receiver waiting for the item
+  __sCriticalRegionEnd();
+
+  __sYieldIfWoken(yield);
+  return sTrue;
+}
+
+sbool_t sRTOSQueueSendFromISR(sQueueHandle_t *queueHandle, void *itemPtr, sbool_t *higherPriorityWoken)
 {
   __sCriticalRegionBegin();
   if (queueHandle->lenght == queueHandle->maxLenght)
   {
+#if __sUSE_OBJECT_STATS == 1
+    queueHandle->stats.fullEvents++;
+#endif
     __sCriticalRegionEnd();
     return sFalse;
   }
-  
-  void *temp = malloc(queueHandle->itemSize);
-  if (temp == NULL)
+  _queueWrite(queueHandle, itemPtr);
+  __sReportWoken(higherPriorityWoken, _queueWakeWaiter(&queueHandle->receiveWaitList));
+  __sCriticalRegionEnd();
+  return sTrue;
+}
+
+sbool_t sRTOSQueueReceiveFromISR(sQueueHandle_t *queueHandle, void *itemPtr, sbool_t *higherPriorityWoken)
+{
+  __sCriticalRegionBegin();
+  if (queueHandle->lenght == 0)
   {
+#if __sUSE_OBJECT_STATS == 1
+    queueHandle->stats.emptyEvents++;
+#endif
     __sCriticalRegionEnd();
     return sFalse;
   }
-  memcpy(temp, itemPtr, queueHandle->itemSize);
-  queueHandle->index++;
-  sUBaseType_t writePos = queueHandle->index % queueHandle->maxLenght;
-  queueHandle->items[writePos] = temp;
-  queueHandle->lenght++;
+  _queueRead(queueHandle, itemPtr);
+  __sReportWoken(higherPriorityWoken, _queueWakeWaiter(&queueHandle->sendWaitList));
   __sCriticalRegionEnd();
   return sTrue;
-}
\ No newline at end of file
+}
@@ -0,0 +1,217 @@
+/*
+ * simpleRTOSRwLock.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: brachiGH
+ */
+
+#include "simpleRTOS.h"
+
+extern void _changeTaskPriority(sTaskHandle_t *task, sPriority_t priority);
+extern sbool_t _sInheritFromWaiters(sTaskHandle_t *holder, sTaskHandle_t *waitList);
+extern void _sHeldLocksAdd(sTaskHandle_t *task, sBaseType_t delta);
+extern sbool_t _sReleaseInheritance(sTaskHandle_t *task);
+extern sbool_t _sBlockCurrentTask(sUBaseType_t timeoutTicks);
+extern void _sWakeTask(sTaskHandle_t *task);
+extern void _sWaitListAppend(sTaskHandle_t **list, sTaskHandle_t *task);
+extern void _sWaitListRemove(sTaskHandle_t **list, sTaskHandle_t *task);
+
+extern sTaskHandle_t *_sCurrentTask;
+
+void sRTOSRwLockCreate(sRwLock_t *lock)
+{
+  lock->readers = 0;
+  lock->writer = NULL;
+  lock->waitingWriters = 0;
+  lock->waitList = NULL;
+}
+
+// readers are held back while a writer waits, this gives writers preference
+__STATIC_FORCEINLINE__ sbool_t _rwLockIsFree(sRwLock_t *lock, sbool_t exclusive)
+{
+  if (exclusive)
+    return (sbool_t)(lock->writer == NULL && lock->readers == 0);
+
+  return (sbool_t)(lock->writer == NULL && lock->waitingWriters == 0);
+}
+
+// hands the lock to the tasks in the wait list that can own it now,
+// a waiting writer is always served before the readers.
+// returns sTrue if a woken task has a higher priority than the current task.
+// note: must be called inside a critical region
+static sbool_t _rwLockWakeWaiters(sRwLock_t *lock)
+{
+  sbool_t yield = sFalse;
+
+  if (lock->writer != NULL)
+    return sFalse;
+
+  sTaskHandle_t *waiter = lock->waitList;
+  while (waiter != NULL && !waiter->exclusiveWait)
+  {
+    waiter = waiter->nextWaiter;
+  }
+
+  if (waiter != NULL)
+  {
+    if (lock->readers != 0)
+      return sFalse; // the writer is woken by the last reader
+
+    _sWaitListRemove(&lock->waitList, waiter);
+    lock->waitingWriters--;
+    lock->writer = waiter;
+    _sHeldLocksAdd(waiter, 1);
+    waiter->waitGranted = sTrue;
+    _sWakeTask(waiter);
+    _sInheritFromWaiters(waiter, lock->waitList); // the tasks still waiting now wait for the new writer
+    return (sbool_t)(waiter->priority > _sCurrentTask->priority);
+  }
+
+  // no writer is waiting, every blocked reader can own the lock
+  while (lock->waitList != NULL)
+  {
+    waiter = lock->waitList;
+    lock->waitList = waiter->nextWaiter;
+    waiter->nextWaiter = NULL;
+    waiter->waitList = NULL;
+    lock->readers++;
+    waiter->waitGranted = sTrue;
+    _sWakeTask(waiter);
+    if (waiter->priority > _sCurrentTask->priority)
+      yield = sTrue;
+  }
+  return yield;
+}
+
+// a writer blocked on the lock owning waitList was deleted and unlinked (_sWaitListForget):
+// the readers it held back may own the lock now.
+// returns sTrue if a woken task has a higher priority than the current task.
+// note: must be called inside a critical region
+sbool_t _sRwLockWriterForgotten(sTaskHandle_t **waitList)
+{
+  sRwLock_t *lock = (sRwLock_t *)((uint8_t *)waitList - offsetof(sRwLock_t, waitList));
+  return _rwLockWakeWaiters(lock);
+}
+
+static sbool_t _rwLockTake(sRwLock_t *lock, sbool_t exclusive, sUBaseType_t timeoutTicks)
+{
+  __sCriticalRegionBegin();
+  if (_rwLockIsFree(lock, exclusive))
+  {
+    if (exclusive)
+    {
+      lock->writer = _sCurrentTask;
+      _sHeldLocksAdd(_sCurrentTask, 1);
+    }
+    else
+      lock->readers++;
+    __sCriticalRegionEnd();
+    return sTrue;
+  }
+
+  if (timeoutTicks == 0)
+  {
+    __sCriticalRegionEnd();
+    return sFalse;
+  }
+
+  _sCurrentTask->exclusiveWait = exclusive;
+  _sCurrentTask->waitGranted = sFalse;
+  if (exclusive)
+    lock->waitingWriters++;
+  _sWaitListAppend(&lock->waitList, _sCurrentTask);
+  _sCurrentTask->waitCount = exclusive ? (volatile sUBaseType_t *)&lock->waitingWriters : NULL;
+  _sCurrentTask->waitHolder = &lock->writer;
+
+  // the writer inherits the priority of the tasks it blocks, until it releases the lock
+  sTaskHandle_t *writer = lock->writer;
+  if (writer != NULL && writer->priority < _sCurrentTask->priority)
+  {
+    writer->inheritedPriority = _sCurrentTask->priority;
+    _changeTaskPriority(writer, _sCurrentTask->priority);
+  }
+
+  if (!_sBlockCurrentTask(timeoutTicks))
+  {
+    _sWaitListRemove(&lock->waitList, _sCurrentTask);
+    if (exclusive)
+      lock->waitingWriters--;
+    if (writer != NULL)
+      _sInheritFromWaiters(writer, lock->waitList);
+    _sCurrentTask->exclusiveWait = sFalse;
+    __sCriticalRegionEnd();
+    return sFalse;
+  }
+  __sCriticalRegionEnd();
+  sRTOSTaskYield(); // runs again when the lock is handed over or when the timeout expires
+
+  __sCriticalRegionBegin();
+  sbool_t granted = _sCurrentTask->waitGranted;
+  sbool_t yield = sFalse;
+  if (!granted)
+  {
+    _sWaitListRemove(&lock->waitList, _sCurrentTask);
+    if (exclusive)
+    {
+      lock->waitingWriters--;
+      yield = _rwLockWakeWaiters(lock); // readers held back by this writer can now proceed
+    }
+    if (lock->writer != NULL) // the writer drops the priority it inherited from this task
+      _sInheritFromWaiters(lock->writer, lock->waitList);
+  }
+  _sCurrentTask->waitGranted = sFalse;
+  _sCurrentTask->exclusiveWait = sFalse; // only set while blocked as a writer, _sWaitListForget relies on it
+  __sCriticalRegionEnd();
+
+  if (yield)
+    sRTOSTaskYield();
+  return granted;
+}
+
+sbool_t sRTOSRwLockReadTake(sRwLock_t *lock, sUBaseType_t timeoutTicks)
+{
+  return _rwLockTake(lock, sFalse, timeoutTicks);
+}
+
+sbool_t sRTOSRwLockWriteTake(sRwLock_t *lock, sUBaseType_t timeoutTicks)
+{
+  return _rwLockTake(lock, sTrue, timeoutTicks);
+}
+
+sbool_t sRTOSRwLockReadGive(sRwLock_t *lock)
+{
+  __sCriticalRegionBegin();
+  if (lock->readers <= 0)
+  {
+    __sCriticalRegionEnd();
+    return sFalse;
+  }
+
+  lock->readers--;
+  sbool_t yield = (lock->readers == 0) ? _rwLockWakeWaiters(lock) : sFalse;
+  __sCriticalRegionEnd();
+
+  __sYieldIfWoken(yield);
+  return sTrue;
+}
+
+sbool_t sRTOSRwLockWriteGive(sRwLock_t *lock)
+{
+  __sCriticalRegionBegin();
+  if (lock->writer != _sCurrentTask)
+  {
+    __sCriticalRegionEnd();
+    return sFalse;
+  }
+
+  lock->writer = NULL;
+  sbool_t yield = _rwLockWakeWaiters(lock);
+
+  _sHeldLocksAdd(_sCurrentTask, -1);
+  if (_sReleaseInheritance(_sCurrentTask)) // the priority inherited is kept while it holds another lock
+    yield = sTrue;
+  __sCriticalRegionEnd();
+
+  __sYieldIfWoken(yield);
+  return sTrue;
+}
@@ -14,41 +14,111 @@
 #define SYST_CVR (*((volatile uint32_t *)0xE000E018))
 #define SYST_CALIB (*((volatile uint32_t *)0xE000E01C))
 
+#define SYSPRI2 (*((volatile uint32_t *)0xE000ED1C))
 #define SYSPRI3 (*((volatile uint32_t *)0xE000ED20))
+#define SHCSR (*((volatile uint32_t *)0xE000ED24))
 
 /*************PV*****************/
+#if __sUSE_STATIC_CONFIG == 1
+// defined with their initial values in the generated sRTOSStaticConfig.c
+extern volatile sUBaseType_t __TaskPriorityBitMap;
+extern sTaskHandle_t *_sTaskList[MAX_TASK_PRIORITY_COUNT];
+extern sUBaseType_t _sNumberOfReadyTaskPerPriority[MAX_TASK_PRIORITY_COUNT];
+extern sTaskHandle_t *__IdleTask;
+extern void _sStaticKernelInit(void);
+#else
 volatile sUBaseType_t __TaskPriorityBitMap = 0x0; // each bit represent a priority if set to 1 then thier are tasks to execute with that priority
 sTaskHandle_t *_sTaskList[MAX_TASK_PRIORITY_COUNT] = {NULL};
 sUBaseType_t _sNumberOfReadyTaskPerPriority[MAX_TASK_PRIORITY_COUNT] = {0};
 sTaskHandle_t *__IdleTask;
-volatile sUBaseType_t _sTicksPassedExecutingCurrentTask = __sQUANTA; // set to __sQUANTA so the scheduler can begin without waiting for a quantum of time to pass
+#endif
+#if __sQUANTA == 0 || __sQUANTA >= __sQUANTA_EXPIRED
+#error "__sQUANTA must be between 1 and __sQUANTA_EXPIRED - 1"
+#endif
+volatile sUBaseType_t _sTicksPassedExecutingCurrentTask = __sQUANTA_EXPIRED; // set to __sQUANTA_EXPIRED so the scheduler can begin without waiting for a quantum of time to pass
 
 sTaskHandle_t *_sCurrentTask;
+
+#if __sUSE_PARTITIONS == 1
+#if __sPARTITION_COUNT < 2 || __sPARTITION_COUNT > 8
+#error "__sPARTITION_COUNT must be between 2 and 8"
+#endif
+// the system partition (0) uses _sTaskList and __TaskPriorityBitMap, the other partitions have their own ready lists
+static sTaskHandle_t *__PartitionTaskList[__sPARTITION_COUNT - 1][MAX_TASK_PRIORITY_COUNT];
+static sUBaseType_t __PartitionReadyTasks[__sPARTITION_COUNT - 1][MAX_TASK_PRIORITY_COUNT];
+static volatile sUBaseType_t __PartitionPriorityBitMap[__sPARTITION_COUNT - 1];
+
+static sPartitionWindow_t __PartitionWindows[__sMAX_PARTITION_WINDOWS];
+static sUBaseType_t __PartitionWindowCount = 0; // 0: no schedule, every partition can run
+static sUBaseType_t __PartitionWindowIndex = 0;
+static sTick_t __PartitionWindowEnd = 0;
+
+#define READY_LIST(partition) ((partition) == 0 ? _sTaskList : __PartitionTaskList[(partition) - 1])
+#define READY_TASKS(partition) ((partition) == 0 ? _sNumberOfReadyTaskPerPriority : __PartitionReadyTasks[(partition) - 1])
+#define READY_BITMAP(partition) (*((partition) == 0 ? &__TaskPriorityBitMap : &__PartitionPriorityBitMap[(partition) - 1]))
+#define ALL_PARTITIONS ((1u << __sPARTITION_COUNT) - 1)
+#else
+#define READY_LIST(partition) _sTaskList
+#define READY_TASKS(partition) _sNumberOfReadyTaskPerPriority
+#define READY_BITMAP(partition) __TaskPriorityBitMap
+#endif
 /********************************/
 
+#if __sUSE_TIMER_DAEMON == 1
+extern sRTOS_StatusTypeDef _sTimerDaemonCreate(void);
+#endif
+#if __sUSE_DEFERRED_WORK == 1
+extern sRTOS_StatusTypeDef _sDeferredWorkCreate(void);
+#endif
+#if __sUSE_COROUTINES == 1
+extern sRTOS_StatusTypeDef _sCoroutineSchedulerCreate(void);
+#endif
+#if __sUSE_LATENCY_STATS == 1 || __sUSE_CRITICAL_STATS == 1
+extern void _sLatencyClockInit(void);
+#endif
+#if __sUSE_LATENCY_STATS == 1
+extern void _sLatencySwitchIn(sTaskHandle_t *task);
+#endif
+#if __sUSE_BASIC_TASKS == 1
+extern sTaskHandle_t *_sBasicTaskDispatch(sTaskHandle_t *task, sTaskHandle_t **list);
+#endif
+
+#if __sUSE_CPU_BUDGETS == 1
+extern void _sBudgetTick(void);
+#endif
+#if __sUSE_FAIR_SHARE == 1
+extern void _sFairShareInsert(sTaskHandle_t *task);
+extern void _sFairShareRemove(sTaskHandle_t *task);
+extern void _sFairShareTick(void);
+extern sTaskHandle_t *_sFairSharePick(sTaskHandle_t *head, sUBaseType_t readyTasks);
+#endif
+
+extern void _sReclaimDeletedTasks(void);
+
 void _idle(void *)
 {
   for (;;)
   {
+    _sReclaimDeletedTasks(); // the idle task only runs when no other task is ready, so a deleted task is never running here
     sRTOSTaskYield();
   }
 }
 
-void _readyTaskCounterInc(sPriority_t priority)
+void _readyTaskCounterInc(sTaskHandle_t *task)
 {
-  sUBaseType_t priorityIndex = priority + (MAX_TASK_PRIORITY_COUNT / 2); // MAX_TASK_PRIORITY_COUNT/2 is because the priority start from -16 to 15
-  _sNumberOfReadyTaskPerPriority[priorityIndex]++;                       // count the number of tasks for each priority
-  __TaskPriorityBitMap |= 1u << priorityIndex;                         // set correspanding bit to 1 to tell the scheduler thier is a task to execute
+  sUBaseType_t priorityIndex = task->priority + (MAX_TASK_PRIORITY_COUNT / 2); // MAX_TASK_PRIORITY_COUNT/2 is because the priority start from -16 to 15
+  READY_TASKS(task->partition)[priorityIndex]++;                               // count the number of tasks for each priority
+  READY_BITMAP(task->partition) |= 1u << priorityIndex;                        // set correspanding bit to 1 to tell the scheduler thier is a task to execute
 }
 
-void __readyTaskCounterDec(sPriority_t priority)
+void __readyTaskCounterDec(sTaskHandle_t *task)
 {
-  sUBaseType_t priorityIndex = priority + (MAX_TASK_PRIORITY_COUNT / 2);
+  sUBaseType_t priorityIndex = task->priority + (MAX_TASK_PRIORITY_COUNT / 2);
 
-  _sNumberOfReadyTaskPerPriority[priorityIndex]--;
-  if (_sNumberOfReadyTaskPerPriority[priorityIndex] == 0)
+  READY_TASKS(task->partition)[priorityIndex]--;
+  if (READY_TASKS(task->partition)[priorityIndex] == 0)
   {
-    __TaskPriorityBitMap &= ~(1u << priorityIndex); // set correspanding bit to 0 to tell the scheduler thier is no task to execute
+    READY_BITMAP(task->partition) &= ~(1u << priorityIndex); // set correspanding bit to 0 to tell the scheduler thier is no task to execute
   }
 }
 
@@ -58,14 +128,19 @@ void _insertTask(sTaskHandle_t *task)
   __sCriticalRegionBegin();
   sPriority_t priority = task->priority;
   sUBaseType_t priorityIndex = priority + (MAX_TASK_PRIORITY_COUNT / 2); // MAX_TASK_PRIORITY_COUNT/2 is because the priority start from -16 to 15
-  _readyTaskCounterInc(priority);
+  sTaskHandle_t **list = &READY_LIST(task->partition)[priorityIndex];
+  _readyTaskCounterInc(task);
 
-  sTaskHandle_t *head = _sTaskList[priorityIndex];
+  sTaskHandle_t *head = *list;
   if (head == NULL)
   {
     task->nextTask = task;
     task->prevTask = task;
-    _sTaskList[priorityIndex] = task;
+    *list = task;
+#if __sUSE_FAIR_SHARE == 1
+    if (priority == __sFAIR_SHARE_PRIORITY)
+      _sFairShareInsert(task);
+#endif
     __sCriticalRegionEnd();
     return;
   }
@@ -77,8 +152,12 @@ void _insertTask(sTaskHandle_t *task)
   task->prevTask = tail;
   tail->nextTask = task;
   head->prevTask = task;
-  _sTaskList[priorityIndex] = task;
+  *list = task;
 
+#if __sUSE_FAIR_SHARE == 1
+  if (priority == __sFAIR_SHARE_PRIORITY)
+    _sFairShareInsert(task);
+#endif
   __sCriticalRegionEnd();
   return;
 }
@@ -88,15 +167,16 @@ void _deleteTask(sTaskHandle_t *task, sbool_t freeMem)
   __sCriticalRegionBegin();
   sPriority_t priority = task->priority;
   sUBaseType_t priorityIndex = priority + (MAX_TASK_PRIORITY_COUNT / 2);
-  __readyTaskCounterDec(priority);
+  sTaskHandle_t **list = &READY_LIST(task->partition)[priorityIndex];
+  __readyTaskCounterDec(task);
 
-  sTaskHandle_t *head = _sTaskList[priorityIndex];
+  sTaskHandle_t *head = *list;
 
   if (head != NULL)
   {
-    if (head == task) // only element in list
+    if (head == task && task->nextTask == task) // only element in list
     {
-      _sTaskList[priorityIndex] = NULL;
+      *list = NULL;
     }
     else
     {
@@ -106,9 +186,9 @@ void _deleteTask(sTaskHandle_t *task, sbool_t freeMem)
       prev->nextTask = next;
       next->prevTask = prev;
 
-      if (_sTaskList[priorityIndex] == task)
+      if (*list == task)
       {
-        _sTaskList[priorityIndex] = next; // move head if we removed it
+        *list = next; // move head if we removed it
       }
     }
   }
@@ -116,16 +196,186 @@ void _deleteTask(sTaskHandle_t *task, sbool_t freeMem)
   // clear links to avoid accidental use
   task->nextTask = NULL;
   task->prevTask = NULL;
+#if __sUSE_FAIR_SHARE == 1
+  _sFairShareRemove(task); // nothing to do if the task is not in a heap
+#endif
 
   __sCriticalRegionEnd();
-  if (freeMem)
+  if (freeMem && !task->isStatic)
   {
-    free(task->stackBase);
-    free(task);
+    // the tcb is owned by the caller of sRTOSTaskCreate, only the stack comes from the kernel heap
+    sRTOSFree(task->stackBase);
+    task->stackBase = NULL;
   }
   return;
 }
 
+// moves a task to another priority level, the task is re-linked only if it is in the ready list.
+// note: _deleteTask must run before the priority changes because it uses it to find the task list
+void _changeTaskPriority(sTaskHandle_t *task, sPriority_t priority)
+{
+  if (task->priority == priority)
+    return;
+
+  if (task->status == sReady || task->status == sRunning)
+  {
+    _deleteTask(task, sFalse);
+    task->priority = priority;
+    _insertTask(task);
+  }
+  else
+  {
+    task->priority = priority;
+  }
+}
+
+// priority a task runs at: its own priority (sPriorityIdle while its CPU budget is throttled),
+// or the priority it inherited from the tasks blocked on a lock it holds if that is higher
+sPriority_t _sTaskBasePriority(sTaskHandle_t *task)
+{
+#if __sUSE_CPU_BUDGETS == 1
+  sPriority_t ownPriority = task->budgetThrottled ? sPriorityIdle : task->originalPriority; // demoted until the replenishment
+#else
+  sPriority_t ownPriority = task->originalPriority;
+#endif
+  return (task->inheritedPriority > ownPriority) ? task->inheritedPriority : ownPriority;
+}
+
+// moves a task back to its base priority, after an inherited priority, its own priority or its budget changed.
+// returns sTrue if the priority changed.
+// note: must be called inside a critical region
+sbool_t _sRestoreTaskPriority(sTaskHandle_t *task)
+{
+  sPriority_t basePriority = _sTaskBasePriority(task);
+  if (task->priority == basePriority)
+    return sFalse;
+
+  _changeTaskPriority(task, basePriority);
+  return sTrue;
+}
+
+// counts the locks a task holds that can raise its priority (mutexes, rwlock write side),
+// delta is 1 when one is taken or handed to the task and -1 when it is released.
+// note: lock-free, the fast paths call it outside of any critical region
+void _sHeldLocksAdd(sTaskHandle_t *task, sBaseType_t delta)
+{
+  sUBaseType_t value;
+  do
+  {
+    value = __sLoadExclusive(&task->heldLocks);
+  } while (__sStoreExclusive(&task->heldLocks, value + (sUBaseType_t)delta));
+}
+
+// the task released a lock: the inherited priority is dropped once it holds no other lock,
+// as the tasks blocked on the other locks still wait for it (a throttled budget keeps its demotion).
+// returns sTrue if the priority of the task changed.
+// note: must be called inside a critical region, after _sHeldLocksAdd(task, -1)
+sbool_t _sReleaseInheritance(sTaskHandle_t *task)
+{
+  if (task->heldLocks != 0)
+    return sFalse;
+
+  task->inheritedPriority = sPriorityMin;
+  return _sRestoreTaskPriority(task);
+}
+
+// the holder of a lock inherits the highest priority of the tasks blocked in its wait list,
+// recomputed when the lock is handed over and when a waiter gives up.
+// while the holder owns other locks the priority they raised it to is kept, it is dropped
+// only when the last lock is released (_sReleaseInheritance).
+// returns sTrue if the priority of the holder changed.
+// note: must be called inside a critical region
+sbool_t _sInheritFromWaiters(sTaskHandle_t *holder, sTaskHandle_t *waitList)
+{
+  sPriority_t waitingPriority = sPriorityMin;
+  for (sTaskHandle_t *waiter = waitList; waiter != NULL; waiter = waiter->nextWaiter)
+  {
+    if (waiter->priority > waitingPriority)
+      waitingPriority = waiter->priority;
+  }
+
+  if (holder->heldLocks > 1 && holder->inheritedPriority > waitingPriority)
+    waitingPriority = holder->inheritedPriority;
+  holder->inheritedPriority = waitingPriority;
+  return _sRestoreTaskPriority(holder);
+}
+
+#if __sUSE_PARTITIONS == 1
+sRTOS_StatusTypeDef sRTOSPartitionSetSchedule(const sPartitionWindow_t *windows, sUBaseType_t count)
+{
+  if (count > __sMAX_PARTITION_WINDOWS || (count != 0 && windows == NULL))
+    return sRTOS_ERROR;
+
+  for (sUBaseType_t i = 0; i < count; i++)
+  {
+    if (windows[i].partition >= __sPARTITION_COUNT || windows[i].durationTicks == 0)
+      return sRTOS_ERROR;
+  }
+
+  __sCriticalRegionBegin();
+  memcpy(__PartitionWindows, windows, count * sizeof(sPartitionWindow_t));
+  __PartitionWindowCount = count;
+  __PartitionWindowIndex = 0;
+  if (count != 0)
+    __PartitionWindowEnd = sGetTick() + windows[0].durationTicks; // the major frame starts now with the first window
+  __sCriticalRegionEnd();
+  return sRTOS_OK; // applied at the next tick (or the next yield without preemption), it can be set before sRTOSStartScheduler
+}
+
+// returns the mask of the partitions that can run now, and the partition of the current window in active
+// note: must be called inside a critical region
+static sUBaseType_t __eligiblePartitions(sUBaseType_t *active)
+{
+  *active = 0;
+  if (__PartitionWindowCount == 0)
+    return ALL_PARTITIONS; // no schedule, the partitions are only used for grouping
+
+  // the windows the scheduler did not see (critical region, non preemptive task) are skipped,
+  // the major frame keeps its phase
+  sTick_t now = sGetTick();
+  while (now >= __PartitionWindowEnd)
+  {
+    __PartitionWindowIndex = (__PartitionWindowIndex + 1) % __PartitionWindowCount;
+    __PartitionWindowEnd += __PartitionWindows[__PartitionWindowIndex].durationTicks;
+  }
+
+  const sPartitionWindow_t *window = &__PartitionWindows[__PartitionWindowIndex];
+  *active = window->partition;
+  if (window->donateIdle && READY_BITMAP(window->partition) == 0)
+    return ALL_PARTITIONS; // the partition has nothing to run, its window goes to the others
+
+  return 1u | (1u << window->partition); // the system partition runs in every window
+}
+
+// returns the ready list of priorityIndex the scheduler picks from: the one of the window's partition
+// if it has a task of this priority, else the first eligible partition that has one
+static sTaskHandle_t **__partitionReadyList(sUBaseType_t eligible, sUBaseType_t active, sUBaseType_t priorityIndex)
+{
+  if (READY_BITMAP(active) & (1u << priorityIndex))
+    return &READY_LIST(active)[priorityIndex];
+
+  for (sUBaseType_t partition = 0; partition < __sPARTITION_COUNT; partition++)
+  {
+    if ((eligible & (1u << partition)) && (READY_BITMAP(partition) & (1u << priorityIndex)))
+      return &READY_LIST(partition)[priorityIndex];
+  }
+  return &_sTaskList[priorityIndex]; // never reached: priorityIndex was taken from the eligible bitmaps
+}
+#endif
+
+#if __sUSE_CPU_BUDGETS == 1 || __sUSE_FAIR_SHARE == 1
+// called by SysTick on every tick, the kernel is locked
+void _sTaskTick(void)
+{
+#if __sUSE_FAIR_SHARE == 1
+  _sFairShareTick(); // first: a budget can move the task out of the fair-share level
+#endif
+#if __sUSE_CPU_BUDGETS == 1
+  _sBudgetTick();
+#endif
+}
+#endif
+
 sRTOS_StatusTypeDef sRTOSInit(sUBaseType_t BUS_FREQ)
 {
   uint32_t PRESCALER = (BUS_FREQ / __sRTOS_SENSIBILITY);
@@ -137,17 +387,53 @@ sRTOS_StatusTypeDef sRTOSInit(sUBaseType_t BUS_FREQ)
   SYST_CVR = 0;                             // clear current value
   SYST_RVR = ((PRESCALER)-1) & 0x00FFFFFFu; // RVR is 24-bit
 
-  /* set PendSV lowest, SysTick just above PendSV (use byte access to avoid endian/shift mistakes) */
+  /* set PendSV lowest, SysTick and SVC just above PendSV (use byte access to avoid endian/shift mistakes)
+   * SVC shares the SysTick priority: both switch tasks, so neither preempts the other,
+   * and both are masked by the critical regions (BASEPRI) */
+#if defined(__ARM_ARCH_6M__)
+  SYSPRI3 = (SYSPRI3 & 0x0000FFFFu) | (0xF0u << 16) | (0xE0u << 24); // ARMv6-M SHPR2/3 are word access only
+  SYSPRI2 = 0xE0u << 24;
+#else
   uint8_t *shpr3 = (uint8_t *)&SYSPRI3;
   shpr3[2] = 0xF0; // PendSV priority byte
   shpr3[3] = 0xE0; // SysTick priority byte
+  ((uint8_t *)&SYSPRI2)[3] = 0xE0; // SVC priority byte
+#endif
+#if __sUSE_LATENCY_STATS == 1 || __sUSE_CRITICAL_STATS == 1
+  _sLatencyClockInit();
+#endif
+#if defined(__ARM_ARCH_8M_MAIN__)
+  SHCSR |= (1u << 18); // a stack limit violation (PSPLIM) is reported as a UsageFault (CFSR.STKOF) instead of a HardFault
+#endif
 
-  __IdleTask = (sTaskHandle_t *)malloc(sizeof(sTaskHandle_t));
+#if __sUSE_STATIC_CONFIG == 1
+  _sStaticKernelInit(); // the tasks are already linked in the ready lists, only the first stack frames are written
+  _sCurrentTask = __IdleTask;
+#else
+  __IdleTask = (sTaskHandle_t *)sRTOSMalloc(sizeof(sTaskHandle_t));
   if (__IdleTask == NULL)
   {
     return sRTOS_ALLOCATION_FAILED;
   }
   _sCurrentTask = __IdleTask;
+#endif
+
+#if __sUSE_TIMER_DAEMON == 1
+  if (_sTimerDaemonCreate() != sRTOS_OK)
+    return sRTOS_ALLOCATION_FAILED;
+#endif
+#if __sUSE_DEFERRED_WORK == 1
+  if (_sDeferredWorkCreate() != sRTOS_OK)
+    return sRTOS_ALLOCATION_FAILED;
+#endif
+#if __sUSE_COROUTINES == 1
+  if (_sCoroutineSchedulerCreate() != sRTOS_OK)
+    return sRTOS_ALLOCATION_FAILED;
+#endif
+
+#if __sUSE_STATIC_CONFIG == 1
+  return sRTOS_OK;
+#else
   return sRTOSTaskCreate(_idle,
                          "idle task",
                          NULL,
@@ -155,6 +441,7 @@ sRTOS_StatusTypeDef sRTOSInit(sUBaseType_t BUS_FREQ)
                          sPriorityIdle,
                          __IdleTask,
                          srFALSE);
+#endif
 }
 
 sTaskHandle_t *_sRTOSGetFirstAvailableTask(void)
@@ -162,33 +449,71 @@ sTaskHandle_t *_sRTOSGetFirstAvailableTask(void)
 
   sUBaseType_t currentPriorityIndex = _sCurrentTask->priority + (MAX_TASK_PRIORITY_COUNT / 2);
 
-  sUBaseType_t priorityIndex; // priorityIndex of what cloud be the next task of execute
-  unsigned int leadingZeros = __builtin_clz((unsigned int)__TaskPriorityBitMap);
-  priorityIndex = MAX_TASK_PRIORITY_COUNT - (leadingZeros + 1);
+#if __sUSE_PARTITIONS == 1
+  sUBaseType_t activePartition;
+  sUBaseType_t eligible = __eligiblePartitions(&activePartition);
+  sUBaseType_t bitMap = 0;
+  for (sUBaseType_t partition = 0; partition < __sPARTITION_COUNT; partition++)
+  {
+    if (eligible & (1u << partition))
+      bitMap |= READY_BITMAP(partition);
+  }
+#else
+  sUBaseType_t bitMap = __TaskPriorityBitMap;
+#endif
+
+  sUBaseType_t priorityIndex = __sHighestBit(bitMap); // priorityIndex of what cloud be the next task of execute
 
   if (
 #if __sUSE_PREEMPTION == 1
-      _sTicksPassedExecutingCurrentTask >= __sQUANTA // if a quanta has passed then execute another task
+      _sTicksPassedExecutingCurrentTask >= (_sCurrentTask->timeSlice ? _sCurrentTask->timeSlice : __sQUANTA) // if a quanta has passed then execute another task
 
       || priorityIndex > currentPriorityIndex // if a higher priority task is ready run it
+#if __sUSE_PARTITIONS == 1
+      || !(eligible & (1u << _sCurrentTask->partition)) // the window of the current task is over
+#endif
 #else
       1
 #endif
   )
   {
     _sTicksPassedExecutingCurrentTask = 0; // rest counter
-    sTaskHandle_t *task = _sTaskList[priorityIndex];
-    _sTaskList[priorityIndex] = _sTaskList[priorityIndex]->nextTask; // rotate tasks (note that the _sTaskList[priorityIndex] is circular linked list)
+#if __sUSE_PARTITIONS == 1
+    sTaskHandle_t **list = __partitionReadyList(eligible, activePartition, priorityIndex);
+#else
+    sTaskHandle_t **list = &_sTaskList[priorityIndex];
+#endif
+    sTaskHandle_t *task = *list;
+    *list = task->nextTask; // rotate tasks (note that the ready list is circular linked list)
+#if __sUSE_FAIR_SHARE == 1
+    if (priorityIndex == __sFAIR_SHARE_PRIORITY + (MAX_TASK_PRIORITY_COUNT / 2))
+    {
+      // the task with the least virtual runtime, the rotation is kept if the level has more tasks than the heap
+      sTaskHandle_t *fairTask = _sFairSharePick(task, READY_TASKS(task->partition)[priorityIndex]);
+      if (fairTask != NULL)
+        task = fairTask;
+    }
+#endif
 
-    if (task->priority != task->originalPriority)
+    // the priority changes keep the base priority (_sRestoreTaskPriority), this only catches a task left away from it
+    sPriority_t pickedPriority = task->priority;
+    if (_sRestoreTaskPriority(task) && task->priority < pickedPriority)
     {
-      // this means that the mutex or notification has change the priority of the task
-      task->priority = task->originalPriority;
-      _deleteTask(task, sFalse);
-      _insertTask(task);
+      // demoted: it may not be the highest priority ready task anymore, pick again
+      _sTicksPassedExecutingCurrentTask = __sQUANTA_EXPIRED;
+      return _sRTOSGetFirstAvailableTask();
     }
+#if __sUSE_BASIC_TASKS == 1
+    task = _sBasicTaskDispatch(task, list); // a new basic task gets its frame on the basic task stack
+#endif
+#if __sUSE_LATENCY_STATS == 1
+    _sLatencySwitchIn(task);
+#endif
     return task;
   }
 
+#if __sUSE_LATENCY_STATS == 1
+  _sLatencySwitchIn(_sCurrentTask); // made ready again before it was switched out (woken before its yield)
+#endif
   return NULL; // else keep executing current task
 }
@@ -7,111 +7,335 @@
 
 #include "simpleRTOS.h"
 #include "stdlib.h"
+#include "string.h"
 
-extern void _pushTaskNotification(sTaskHandle_t *task, sUBaseType_t *message, sPriority_t priority);
+extern void _changeTaskPriority(sTaskHandle_t *task, sPriority_t priority);
+extern sbool_t _sInheritFromWaiters(sTaskHandle_t *holder, sTaskHandle_t *waitList);
+extern void _sHeldLocksAdd(sTaskHandle_t *task, sBaseType_t delta);
+extern sbool_t _sReleaseInheritance(sTaskHandle_t *task);
+extern sbool_t _sBlockCurrentTask(sUBaseType_t timeoutTicks);
+extern void _sWakeTask(sTaskHandle_t *task);
+extern void _sWaitListAppend(sTaskHandle_t **list, sTaskHandle_t *task);
+extern void _sWaitListRemove(sTaskHandle_t **list, sTaskHandle_t *task);
+#if __sUSE_OBJECT_STATS == 1
+extern void _sObjectStatsAcquire(sObjectStats_t *stats);
+extern void _sObjectStatsWait(sObjectStats_t *stats, sTick_t start, sbool_t acquired);
+#endif
 
 extern sTaskHandle_t *_sCurrentTask;
 
+/*
+ * Semaphores and mutexes are futex-style: while no task waits, take and give are a
+ * single LDREX/STREX loop on the count (or the owner) and interrupts stay enabled.
+ * The critical region is entered only to block a task or to hand the object to a waiter.
+ *
+ * A waiter registers itself (waiters++) inside a critical region. That can only happen
+ * between the LDREX and the STREX of a fast path through an exception, and exception
+ * entry/return clears the exclusive monitor: the STREX fails and the fast path reads
+ * waiters again. Givers hand the object directly to the oldest waiter, so the count
+ * stays 0 (the owner stays set) while tasks are waiting and a fast path can not steal it.
+ */
+
+// blocks the calling task on waitList until a giver hands it the object or the timeout expires.
+// holder is the owner field of a mutex (NULL for a semaphore): on timeout the owner drops
+// the priority it inherited from this task.
+// note: must be called inside a critical region (with waiters already incremented), it exits it
+static sbool_t _waitForHandOff(sTaskHandle_t **waitList, volatile sUBaseType_t *waiters, sTaskHandle_t *volatile *holder, sUBaseType_t timeoutTicks)
+{
+  _sCurrentTask->waitGranted = sFalse;
+  _sWaitListAppend(waitList, _sCurrentTask);
+  _sCurrentTask->waitCount = waiters;
+  _sCurrentTask->waitHolder = holder;
+  if (_sBlockCurrentTask(timeoutTicks))
+  {
+    __sCriticalRegionEnd();
+    sRTOSTaskYield(); // runs again when the object is handed over or when the timeout expires
+    __sCriticalRegionBegin();
+  }
+
+  sbool_t granted = _sCurrentTask->waitGranted;
+  if (!granted)
+  {
+    _sWaitListRemove(waitList, _sCurrentTask);
+    (*waiters)--;
+    if (holder != NULL && *holder != NULL)
+      _sInheritFromWaiters(*holder, *waitList);
+  }
+  _sCurrentTask->waitGranted = sFalse;
+  __sCriticalRegionEnd();
+  return granted;
+}
+
+// removes the oldest waiting task from waitList and wakes it, the caller has already given it the object.
+// note: must be called inside a critical region, with waiters not 0
+static sTaskHandle_t *_handOff(sTaskHandle_t **waitList, volatile sUBaseType_t *waiters)
+{
+  sTaskHandle_t *task = *waitList;
+  _sWaitListRemove(waitList, task);
+  (*waiters)--;
+  task->waitGranted = sTrue;
+  _sWakeTask(task);
+  return task;
+}
+
 void sRTOSSemaphoreCreate(sSemaphore_t *sem, sBaseType_t n)
 {
-  *sem = n;
+  sem->count = n;
+  sem->waiters = 0;
+  sem->waitList = NULL;
+#if __sUSE_OBJECT_STATS == 1
+  memset(&sem->stats, 0, sizeof(sObjectStats_t));
+#endif
 }
 
-void sRTOSSemaphoreGive(sSemaphore_t *sem)
+// returns sTrue if the task the unit is handed to has a higher priority than the current task
+static sbool_t _semaphoreGiveSlow(sSemaphore_t *sem)
 {
   __sCriticalRegionBegin();
-  (*sem)++;
+  if (sem->waiters == 0) // the waiters timed out meanwhile
+  {
+    sem->count++;
+    __sCriticalRegionEnd();
+    return sFalse;
+  }
+
+  sTaskHandle_t *task = _handOff(&sem->waitList, &sem->waiters);
+  sbool_t woken = (sbool_t)(task->priority > _sCurrentTask->priority);
   __sCriticalRegionEnd();
+  return woken;
 }
 
-sbool_t sRTOSSemaphoreTake(sSemaphore_t *sem, sUBaseType_t timeoutTicks)
+static sbool_t _semaphoreGive(sSemaphore_t *sem)
 {
-  sUBaseType_t timeoutFinish = SAT_ADD_U32(sGetTick(), timeoutTicks);
-  __sCriticalRegionBegin();
-  while (*sem <= 0)
+  volatile sUBaseType_t *count = (volatile sUBaseType_t *)&sem->count;
+  sUBaseType_t value;
+  do
   {
-    __sCriticalRegionEnd();
-    if (timeoutFinish <= sGetTick())
+    value = __sLoadExclusive(count);
+    if (sem->waiters != 0)
     {
-      return sFalse;
+      __sClearExclusive();
+      return _semaphoreGiveSlow(sem);
     }
-    __sCriticalRegionBegin();
-  }
+  } while (__sStoreExclusive(count, value + 1));
+  return sFalse;
+}
 
-  (*sem)--;
-  __sCriticalRegionEnd();
-  return sTrue;
+void sRTOSSemaphoreGive(sSemaphore_t *sem)
+{
+  __sYieldIfWoken(_semaphoreGive(sem));
 }
 
-sbool_t sRTOSSemaphoreCooperativeTake(sSemaphore_t *sem, sUBaseType_t timeoutTicks)
+void sRTOSSemaphoreGiveFromISR(sSemaphore_t *sem, sbool_t *higherPriorityWoken)
+{
+  __sReportWoken(higherPriorityWoken, _semaphoreGive(sem));
+}
+
+static sbool_t _semaphoreTakeSlow(sSemaphore_t *sem, sUBaseType_t timeoutTicks)
 {
-  sUBaseType_t timeoutFinish = SAT_ADD_U32(sGetTick(), timeoutTicks);
   __sCriticalRegionBegin();
-  while (*sem <= 0)
+  if (sem->count > 0) // given since the fast path failed
   {
+    sem->count--;
     __sCriticalRegionEnd();
-    if (timeoutFinish <= sGetTick())
-    {
-      return sFalse;
-    }
-    sRTOSTaskYield();
-    __sCriticalRegionBegin();
+#if __sUSE_OBJECT_STATS == 1
+    _sObjectStatsAcquire(&sem->stats);
+#endif
+    return sTrue;
   }
 
-  (*sem)--;
-  __sCriticalRegionEnd();
+  if (timeoutTicks == 0)
+  {
+    __sCriticalRegionEnd();
+    return sFalse;
+  }
+
+  sem->waiters++;
+#if __sUSE_OBJECT_STATS == 1
+  sTick_t start = sGetTick();
+  sbool_t granted = _waitForHandOff(&sem->waitList, &sem->waiters, NULL, timeoutTicks);
+  _sObjectStatsWait(&sem->stats, start, granted);
+  if (granted)
+    _sObjectStatsAcquire(&sem->stats);
+  return granted;
+#else
+  return _waitForHandOff(&sem->waitList, &sem->waiters, NULL, timeoutTicks);
+#endif
+}
+
+sbool_t sRTOSSemaphoreTake(sSemaphore_t *sem, sUBaseType_t timeoutTicks)
+{
+  volatile sUBaseType_t *count = (volatile sUBaseType_t *)&sem->count;
+  sBaseType_t value;
+  do
+  {
+    value = (sBaseType_t)__sLoadExclusive(count);
+    if (value <= 0)
+    {
+      __sClearExclusive();
+      return _semaphoreTakeSlow(sem, timeoutTicks);
+    }
+  } while (__sStoreExclusive(count, (sUBaseType_t)(value - 1)));
+#if __sUSE_OBJECT_STATS == 1
+  _sObjectStatsAcquire(&sem->stats);
+#endif
   return sTrue;
 }
 
+sbool_t sRTOSSemaphoreCooperativeTake(sSemaphore_t *sem, sUBaseType_t timeoutTicks)
+{
+  return sRTOSSemaphoreTake(sem, timeoutTicks);
+}
+
 void sRTOSMutexCreate(sMutex_t *mux)
 {
-  mux->sem = 1;
   mux->holderHandle = NULL;
+  mux->waiters = 0;
+  mux->waitList = NULL;
+#if __sUSE_OBJECT_STATS == 1
+  memset(&mux->stats, 0, sizeof(sObjectStats_t));
+#endif
 }
 
-sbool_t sRTOSMutexGive(sMutex_t *mux)
+// releases the mutex held by owner: ownership goes to the oldest waiter (which inherits the
+// priority of the tasks still waiting), and owner drops the priority it inherited if it holds no other lock.
+// yield is set if the current task may no longer be the highest priority ready task.
+static sbool_t _mutexGiveSlow(sMutex_t *mux, sTaskHandle_t *owner, sbool_t *yield)
 {
-  if (mux->sem == 1 || mux->holderHandle != _sCurrentTask)
-    return sFalse;
+  *yield = sFalse;
 
   __sCriticalRegionBegin();
-  _pushTaskNotification(mux->requesterHandle, NULL, _sCurrentTask->priority);
-  mux->sem++;
+  if (mux->holderHandle != owner) // released by another context meanwhile
+  {
+    __sCriticalRegionEnd();
+    return sFalse;
+  }
+
+  if (mux->waiters != 0)
+  {
+    sTaskHandle_t *task = mux->waitList;
+    mux->holderHandle = task;
+    _sHeldLocksAdd(task, 1);
+    _handOff(&mux->waitList, &mux->waiters);
+    *yield = (sbool_t)(task->priority > _sCurrentTask->priority);
+    _sInheritFromWaiters(task, mux->waitList); // the tasks still waiting now wait for the new owner
+  }
+  else
+  {
+    mux->holderHandle = NULL;
+  }
+
+  _sHeldLocksAdd(owner, -1);
+  if (_sReleaseInheritance(owner) && owner == _sCurrentTask)
+    *yield = sTrue;
   __sCriticalRegionEnd();
-  sRTOSTaskYield();
   return sTrue;
 }
 
-sbool_t sRTOSMutexGiveFromISR(sMutex_t *mux)
+sbool_t sRTOSMutexGive(sMutex_t *mux)
 {
-  if (mux->sem == 1)
-    return sFalse;
-
-  __sCriticalRegionBegin();
-  _pushTaskNotification(mux->requesterHandle, NULL, sPriorityMax); // ISRs have a higher priority then any task;
-  mux->sem++;
-  __sCriticalRegionEnd();
+  volatile sUBaseType_t *holder = (volatile sUBaseType_t *)&mux->holderHandle;
+  do
+  {
+    if (__sLoadExclusive(holder) != (sUBaseType_t)_sCurrentTask)
+    {
+      __sClearExclusive();
+      return sFalse;
+    }
+    if (mux->waiters != 0 || _sCurrentTask->inheritedPriority != sPriorityMin)
+    {
+      __sClearExclusive();
+      sbool_t yield;
+      sbool_t released = _mutexGiveSlow(mux, _sCurrentTask, &yield);
+      __sYieldIfWoken(yield);
+      return released;
+    }
+  } while (__sStoreExclusive(holder, 0));
+  _sHeldLocksAdd(_sCurrentTask, -1);
   return sTrue;
 }
 
-sbool_t sRTOSMutexTake(sMutex_t *mux, sUBaseType_t timeoutTicks)
+sbool_t sRTOSMutexGiveFromISR(sMutex_t *mux, sbool_t *higherPriorityWoken)
 {
-  sUBaseType_t timeoutFinish = SAT_ADD_U32(sGetTick(), timeoutTicks);
-  __sCriticalRegionBegin();
-  mux->requesterHandle = _sCurrentTask;
-  while (mux->sem <= 0)
+  volatile sUBaseType_t *holder = (volatile sUBaseType_t *)&mux->holderHandle;
+  sTaskHandle_t *owner;
+  do
   {
-    __sCriticalRegionEnd();
-    if (timeoutFinish <= sGetTick())
+    owner = (sTaskHandle_t *)__sLoadExclusive(holder);
+    if (owner == NULL)
     {
+      __sClearExclusive();
       return sFalse;
     }
-    sRTOSTaskYield();
-    __sCriticalRegionBegin();
+    if (mux->waiters != 0 || owner->inheritedPriority != sPriorityMin)
+    {
+      __sClearExclusive();
+      sbool_t woken;
+      sbool_t released = _mutexGiveSlow(mux, owner, &woken);
+      __sReportWoken(higherPriorityWoken, woken);
+      return released;
+    }
+  } while (__sStoreExclusive(holder, 0));
+  _sHeldLocksAdd(owner, -1);
+  return sTrue;
+}
+
+static sbool_t _mutexTakeSlow(sMutex_t *mux, sUBaseType_t timeoutTicks)
+{
+  __sCriticalRegionBegin();
+  sTaskHandle_t *holder = mux->holderHandle;
+  if (holder == NULL) // released since the fast path failed
+  {
+    mux->holderHandle = _sCurrentTask;
+    _sHeldLocksAdd(_sCurrentTask, 1);
+    __sCriticalRegionEnd();
+#if __sUSE_OBJECT_STATS == 1
+    _sObjectStatsAcquire(&mux->stats);
+#endif
+    return sTrue;
   }
 
-  mux->holderHandle = _sCurrentTask;
-  mux->sem--;
-  __sCriticalRegionEnd();
+  if (timeoutTicks == 0 || holder == _sCurrentTask) // the mutex is not recursive
+  {
+    __sCriticalRegionEnd();
+    return sFalse;
+  }
+
+  mux->waiters++;
+
+  // the owner inherits the priority of the tasks it blocks, until it releases the mutex
+  if (holder->priority < _sCurrentTask->priority)
+  {
+    holder->inheritedPriority = _sCurrentTask->priority;
+    _changeTaskPriority(holder, _sCurrentTask->priority);
+  }
+
+#if __sUSE_OBJECT_STATS == 1
+  sTick_t start = sGetTick();
+  sbool_t granted = _waitForHandOff(&mux->waitList, &mux->waiters, &mux->holderHandle, timeoutTicks);
+  _sObjectStatsWait(&mux->stats, start, granted);
+  if (granted)
+    _sObjectStatsAcquire(&mux->stats);
+  return granted;
+#else
+  return _waitForHandOff(&mux->waitList, &mux->waiters, &mux->holderHandle, timeoutTicks);
+#endif
+}
+
+sbool_t sRTOSMutexTake(sMutex_t *mux, sUBaseType_t timeoutTicks)
+{
+  volatile sUBaseType_t *holder = (volatile sUBaseType_t *)&mux->holderHandle;
+  do
+  {
+    if (__sLoadExclusive(holder) != 0)
+    {
+      __sClearExclusive();
+      return _mutexTakeSlow(mux, timeoutTicks);
+    }
+  } while (__sStoreExclusive(holder, (sUBaseType_t)_sCurrentTask));
+  _sHeldLocksAdd(_sCurrentTask, 1);
+#if __sUSE_OBJECT_STATS == 1
+  _sObjectStatsAcquire(&mux->stats);
+#endif
   return sTrue;
-}
\ No newline at end of file
+}
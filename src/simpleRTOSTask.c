@@ -12,10 +12,24 @@
 extern void _deleteTask(sTaskHandle_t *task, sbool_t freeMem);
 extern void _insertTask(sTaskHandle_t *task);
 extern void _removeTaskTimeoutList(sTaskHandle_t *task);
+extern sbool_t _sWaitListForget(sTaskHandle_t *task);
+extern sbool_t _sQueuePassWakeup(sTaskHandle_t *task);
+extern sbool_t _sRestoreTaskPriority(sTaskHandle_t *task);
+#if __sUSE_LATENCY_STATS == 1
+extern void _sLatencyReady(sTaskHandle_t *task);
+#endif
+#if __sUSE_CPU_BUDGETS == 1
+extern void _sBudgetForget(sTaskHandle_t *task);
+#endif
 extern sTaskHandle_t *_sCurrentTask;
 
-__STATIC_NAKED__ void _taskReturn(void *)
+static sTaskHandle_t *__DeletedTasks = NULL; // deleted tasks whose stack is not freed yet (linked by nextTask)
+
+// a task that returns from its function deletes itself.
+// also used as the return address of the tasks generated by tools/sRTOSgen.py
+void _taskReturn(void *)
 {
+  sRTOSTaskDelete(NULL);
   for (;;)
   {
   }
@@ -24,8 +38,9 @@ __STATIC_NAKED__ void _taskReturn(void *)
 static sUBaseType_t *_taskInitStack(sTaskFunc_t taskFunc, void *arg,
                                     sUBaseType_t stacksize, sUBaseType_t fpsMode)
 {
-  stacksize = ((fpsMode == srFALSE) ? MIN_STACK_SIZE_NO_FPU : MIN_STACK_SIZE_FPU) + stacksize;
-  sUBaseType_t *stack = (sUBaseType_t *)malloc(sizeof(sUBaseType_t) * (stacksize));
+  // the guard words sit below the task stack, under the hardware stack limit on ARMv8-M
+  stacksize = ((fpsMode == srFALSE) ? MIN_STACK_SIZE_NO_FPU : MIN_STACK_SIZE_FPU) + stacksize + STACK_LIMIT_GUARD_WORDS;
+  sUBaseType_t *stack = (sUBaseType_t *)sRTOSMalloc(sizeof(sUBaseType_t) * (stacksize));
   if (stack == NULL)
     return NULL;
 
@@ -92,17 +107,53 @@ sRTOS_StatusTypeDef sRTOSTaskCreate(
    *
    * Systic (interrupt handler) pushes registers (r4–r11).
    */
-  taskHandle->stackPt = (sUBaseType_t *)(stack + stacksizeWords); // stack pointer, after stack frame
+  taskHandle->stackPt = (sUBaseType_t *)(stack + STACK_LIMIT_GUARD_WORDS + stacksizeWords); // stack pointer, after stack frame
                                                                   // is saved onto the same stack
+#if defined(__ARM_ARCH_8M_MAIN__)
+  // the first frame is a basic frame, fps tells if the last saved frame holds the FPU registers
+  if (fpsMode != srFALSE)
+    taskHandle->stackPt += MIN_STACK_SIZE_FPU - MIN_STACK_SIZE_NO_FPU;
+  fpsMode = srFALSE;
+#endif
   taskHandle->nextTask = taskHandle;                              // if no other task rerun same task
   taskHandle->prevTask = taskHandle;
   taskHandle->status = sReady;
   taskHandle->regitersSaved = sTrue; // Regiters are intialized on the stack by `_taskInitStack`, this means that thier are saved
   taskHandle->fps = (sbool_t)fpsMode;
   taskHandle->priority = priority;
-  taskHandle->notificationMessage = 0;
-  taskHandle->hasNotification = sFalse;
+  for (sUBaseType_t i = 0; i < __sTASK_NOTIFICATION_SLOTS; i++)
+  {
+    taskHandle->notificationValue[i] = 0;
+    taskHandle->notificationState[i] = sNotificationEmpty;
+  }
   taskHandle->originalPriority = priority;
+  taskHandle->inheritedPriority = sPriorityMin;
+  taskHandle->exclusiveWait = sFalse;
+  taskHandle->waitGranted = sFalse;
+  taskHandle->nextWaiter = NULL;
+  taskHandle->waitList = NULL;
+  taskHandle->heldLocks = 0;
+  taskHandle->stopped = sFalse;
+  taskHandle->isStatic = sFalse;
+  taskHandle->isBasic = sFalse;
+  taskHandle->timeSlice = 0;
+#if __sUSE_FAIR_SHARE == 1
+  taskHandle->fairWeight = __sFAIR_SHARE_DEFAULT_WEIGHT;
+  taskHandle->fairIndex = 0;
+  taskHandle->vruntime = 0; // raised to the virtual runtime of the level when it is inserted
+#endif
+#if __sUSE_CPU_BUDGETS == 1
+  taskHandle->budget = 0;
+  taskHandle->budgetThrottled = sFalse;
+  taskHandle->budgetSuspended = sFalse;
+#endif
+#if __sUSE_PARTITIONS == 1
+  taskHandle->partition = 0;
+#endif
+#if __sUSE_LATENCY_STATS == 1
+  taskHandle->latencyPending = sFalse;
+  memset(&taskHandle->latency, 0, sizeof(sLatencyStats_t));
+#endif
   strncpy(taskHandle->name, name, MAX_TASK_NAME_LEN);
 
   _insertTask(taskHandle);
@@ -112,10 +163,52 @@ sRTOS_StatusTypeDef sRTOSTaskCreate(
 void sRTOSTaskUpdatePriority(sTaskHandle_t *taskHandle, sPriority_t priority)
 {
   __sCriticalRegionBegin();
-  taskHandle->priority = priority;
-  _deleteTask(taskHandle, sFalse);
-  _insertTask(taskHandle);
-  // _deleteTask and _insertTask, exit the criticalRegion at the end
+  taskHandle->originalPriority = priority;
+  // a task holding a lock keeps the priority it inherited until it releases the lock,
+  // and a throttled budget keeps its demotion until the replenishment
+  _sRestoreTaskPriority(taskHandle);
+  __sCriticalRegionEnd();
+}
+
+#if __sUSE_PARTITIONS == 1
+sRTOS_StatusTypeDef sRTOSTaskSetPartition(sTaskHandle_t *taskHandle, sUBaseType_t partition)
+{
+  if (taskHandle == NULL)
+    taskHandle = _sCurrentTask;
+
+  // basic tasks nest on one stack by priority, a window change could leave a preempted one under a task of another partition
+  if (partition >= __sPARTITION_COUNT || taskHandle->isBasic)
+    return sRTOS_ERROR;
+
+  __sCriticalRegionBegin();
+  if (taskHandle->status == sReady || taskHandle->status == sRunning)
+  {
+    _deleteTask(taskHandle, sFalse); // the ready list is found with the old partition
+    taskHandle->partition = partition;
+    _insertTask(taskHandle);
+  }
+  else
+  {
+    taskHandle->partition = partition;
+  }
+  __sCriticalRegionEnd();
+
+  if (taskHandle == _sCurrentTask)
+    sRTOSTaskYield(); // its new partition may not run in the current window
+  return sRTOS_OK;
+}
+#endif
+
+sRTOS_StatusTypeDef sRTOSTaskSetTimeSlice(sTaskHandle_t *taskHandle, sUBaseType_t ticks)
+{
+  if (taskHandle == NULL)
+    taskHandle = _sCurrentTask;
+
+  if (ticks >= __sQUANTA_EXPIRED)
+    return sRTOS_ERROR;
+
+  taskHandle->timeSlice = (uint8_t)ticks; // the running task gets it from its current slice on
+  return sRTOS_OK;
 }
 
 void sRTOSTaskStop(sTaskHandle_t *taskHandle)
@@ -123,28 +216,39 @@ void sRTOSTaskStop(sTaskHandle_t *taskHandle)
   if (taskHandle == NULL)
     taskHandle = _sCurrentTask;
 
-  if (taskHandle->status != sDeleted && taskHandle->status != sBlocked)
+  __sCriticalRegionBegin();
+#if __sUSE_CPU_BUDGETS == 1
+  taskHandle->budgetSuspended = sFalse; // stays stopped after the replenishment
+#endif
+  if (taskHandle->status != sDeleted && !taskHandle->stopped)
   {
+    // a task blocked on an object stays in its wait list, and owns the object
+    // when it is resumed if it was handed over meanwhile
+    taskHandle->stopped = sTrue;
+    sbool_t yield = _sQueuePassWakeup(taskHandle); // a queue wakeup it has not used yet
     if (taskHandle->status == sWaiting)
     {
       _removeTaskTimeoutList(taskHandle);
     }
-    else
+    else if (taskHandle->status != sBlocked)
     {
       _deleteTask(taskHandle, sFalse); //  this removes the task from the list of ready to execute task but it does not free it memory
                                        // thus we can restore it
     }
-
-    __sCriticalRegionBegin();
     taskHandle->status = sBlocked;
     __sCriticalRegionEnd();
 
     if (taskHandle == _sCurrentTask)
     {
       sRTOSTaskYield(); // if the current task deletes itself yield
-      return;
     }
+    else
+    {
+      __sYieldIfWoken(yield);
+    }
+    return;
   }
+  __sCriticalRegionEnd();
 }
 
 /*
@@ -153,37 +257,97 @@ void sRTOSTaskStop(sTaskHandle_t *taskHandle)
  */
 void sRTOSTaskResume(sTaskHandle_t *taskHandle)
 {
-  if (taskHandle->status != sDeleted && taskHandle->status != sReady)
+  __sCriticalRegionBegin();
+#if __sUSE_CPU_BUDGETS == 1
+  taskHandle->budgetSuspended = sFalse; // resumed before the replenishment
+#endif
+  taskHandle->stopped = sFalse;
+  if (taskHandle->status != sDeleted && taskHandle->status != sReady && taskHandle->status != sRunning)
   {
     if (taskHandle->status == sWaiting)
     {
       _removeTaskTimeoutList(taskHandle);
     }
-    __sCriticalRegionBegin();
     taskHandle->status = sReady;
     _insertTask(taskHandle);
-    // _insertTask, exit the criticalRegion at the end
+#if __sUSE_LATENCY_STATS == 1
+    _sLatencyReady(taskHandle);
+#endif
+    sbool_t yield = (sbool_t)(taskHandle->priority > _sCurrentTask->priority);
+    __sCriticalRegionEnd();
 
-    if (taskHandle->priority > _sCurrentTask->priority)
-    {
+    if (yield)
       sRTOSTaskYield();
-      return;
-    }
+    return;
   }
+  __sCriticalRegionEnd();
 }
 
-// if provided a none existing taskHandle nothing happens
+// the task is only unlinked here, its stack is freed later by the idle task (_sReclaimDeletedTasks):
+// a task that deletes itself still runs on its stack until it is switched out
 void sRTOSTaskDelete(sTaskHandle_t *taskHandle)
 {
   if (taskHandle == NULL)
     taskHandle = _sCurrentTask;
 
-  _deleteTask(taskHandle, sTrue);
+  __sCriticalRegionBegin();
+  if (taskHandle->status == sDeleted)
+  {
+    __sCriticalRegionEnd();
+    return;
+  }
+
+  if (taskHandle->status == sWaiting)
+  {
+    _removeTaskTimeoutList(taskHandle);
+  }
+  else if (taskHandle->status != sBlocked)
+  {
+    _deleteTask(taskHandle, sFalse);
+  }
+  sbool_t yield = _sQueuePassWakeup(taskHandle); // a queue wakeup it has not used yet
+  if (_sWaitListForget(taskHandle))               // a give must not hand the object to the deleted task
+    yield = sTrue;
+#if __sUSE_CPU_BUDGETS == 1
+  _sBudgetForget(taskHandle);
+#endif
+  taskHandle->status = sDeleted;
+  taskHandle->nextTask = __DeletedTasks;
+  __DeletedTasks = taskHandle;
+  __sCriticalRegionEnd();
 
   // if the current task deletes itself yield
   if (taskHandle == _sCurrentTask)
   {
     sRTOSTaskYield();
+  }
+  else
+  {
+    __sYieldIfWoken(yield);
+  }
+}
+
+// frees the stacks of the deleted tasks, called by the idle task outside of any critical region
+void _sReclaimDeletedTasks(void)
+{
+  if (__DeletedTasks == NULL)
     return;
+
+  __sCriticalRegionBegin();
+  sTaskHandle_t *task = __DeletedTasks;
+  __DeletedTasks = NULL;
+  __sCriticalRegionEnd();
+
+  while (task != NULL)
+  {
+    sTaskHandle_t *next = task->nextTask;
+    if (!task->isStatic)
+    {
+      // the tcb is owned by the caller of sRTOSTaskCreate, only the stack comes from the kernel heap
+      sRTOSFree(task->stackBase);
+      task->stackBase = NULL;
+    }
+    task->nextTask = NULL;
+    task = next;
   }
 }
@@ -11,28 +11,49 @@
 extern void _readyTaskCounterDec(sPriority_t Priority);
 extern void _insertTask(sTaskHandle_t *task);
 extern void _deleteTask(sTaskHandle_t *task, sbool_t freemem);
+extern sbool_t _sInheritFromWaiters(sTaskHandle_t *holder, sTaskHandle_t *waitList);
+extern sbool_t _sRwLockWriterForgotten(sTaskHandle_t **waitList);
+
+#if __sUSE_TIMER_DAEMON == 1
+extern sbool_t _sTimerDaemonPush(sTimerHandle_t *timerHandle);
+#else
+extern void _sTimerPrepareStack(sTimerHandle_t *timerHandle);
+#endif
+
+#if __sUSE_COROUTINES == 1
+extern void _sCoroutineTimeout(sCoroutine_t *co);
+#endif
+#if __sUSE_LATENCY_STATS == 1
+extern void _sLatencyReady(sTaskHandle_t *task);
+#endif
 
 extern sTaskHandle_t *_sCurrentTask;
-volatile sUBaseType_t __EarliestExpiringTimeout = 0;
+volatile sTick_t __EarliestExpiringTimeout = 0;
 
 typedef struct simpleRTOSTimeout
 {
   sTaskHandle_t *task;
   sTimerHandle_t *timer;
-  sUBaseType_t dontRunUntil; // time in ticks where the task can start running
+  sCoroutine_t *coroutine;
+  sTick_t dontRunUntil; // time in ticks where the task can start running
+  sTick_t deadline;     // timers only: nominal expiry, dontRunUntil is the deadline plus the timer slack
   struct simpleRTOSTimeout *next;
 } simpleRTOSTimeout;
 
 simpleRTOSTimeout *__TimeoutList = NULL;
 
+static sTick_t __LastTimerExpiryTick = 0;
+static sTimerStats_t __TimerStats = {0};
+
 void _sInsertTimeout(simpleRTOSTimeout *timeout)
 {
   __sCriticalRegionBegin();
   if (__TimeoutList == NULL)
   {
+    timeout->next = NULL;
     __TimeoutList = timeout;
     __EarliestExpiringTimeout = timeout->dontRunUntil;
-    __sCriticalRegionBegin();
+    __sCriticalRegionEnd();
     return;
   }
 
@@ -41,19 +62,19 @@ void _sInsertTimeout(simpleRTOSTimeout *timeout)
     __EarliestExpiringTimeout = timeout->dontRunUntil;
     timeout->next = __TimeoutList;
     __TimeoutList = timeout;
-    __sCriticalRegionBegin();
+    __sCriticalRegionEnd();
     return;
   }
 
   simpleRTOSTimeout *curr = __TimeoutList;
-  while (curr->next && curr->next->dontRunUntil < timeout->dontRunUntil)
+  while (curr->next && curr->next->dontRunUntil <= timeout->dontRunUntil)
   {
     curr = curr->next;
   }
 
   timeout->next = curr->next;
   curr->next = timeout;
-  __sCriticalRegionBegin();
+  __sCriticalRegionEnd();
 }
 
 simpleRTOSTimeout *__popFirstDelay(void)
@@ -66,115 +87,218 @@ simpleRTOSTimeout *__popFirstDelay(void)
   simpleRTOSTimeout *first = __TimeoutList;
   __TimeoutList = first->next;
 
-  __EarliestExpiringTimeout = __TimeoutList->dontRunUntil;
+  if (__TimeoutList != NULL)
+  {
+    __EarliestExpiringTimeout = __TimeoutList->dontRunUntil;
+  }
   return first;
 }
 
-void _removeTimerTimeoutList(sTimerHandle_t *timer)
+// true if timeout belongs to the task, timer or coroutine (only one of them is not NULL)
+static sbool_t __isTimeoutOf(simpleRTOSTimeout *timeout, sTaskHandle_t *task, sTimerHandle_t *timer, sCoroutine_t *co)
+{
+  return (sbool_t)((task != NULL && timeout->task == task) ||
+                   (timer != NULL && timeout->timer == timer) ||
+                   (co != NULL && timeout->coroutine == co));
+}
+
+// unlinks the first timeout that belongs to task, timer or coroutine, returns NULL if none is found
+// note: must be called inside a critical region
+static simpleRTOSTimeout *__unlinkTimeout(sTaskHandle_t *task, sTimerHandle_t *timer, sCoroutine_t *co)
 {
-  __sCriticalRegionBegin();
   if (__TimeoutList == NULL)
   {
-    __sCriticalRegionEnd();
-    return;
+    return NULL;
   }
 
-  if (__TimeoutList->timer == timer)
+  if (__isTimeoutOf(__TimeoutList, task, timer, co))
   {
-    simpleRTOSTimeout *temp = __TimeoutList;
-    __TimeoutList = __TimeoutList->next;
-    __sCriticalRegionEnd();
-    free(temp);
-    return;
+    return __popFirstDelay(); // also moves __EarliestExpiringTimeout to the new head
   }
 
   simpleRTOSTimeout *curr = __TimeoutList;
-  while (curr->next && curr->next->timer != timer)
+  while (curr->next && !__isTimeoutOf(curr->next, task, timer, co))
   {
     curr = curr->next;
   }
 
   simpleRTOSTimeout *temp = curr->next;
-  curr->next = temp->next;
+  if (temp != NULL)
+  {
+    curr->next = temp->next;
+  }
+  return temp;
+}
+
+void _removeTimerTimeoutList(sTimerHandle_t *timer)
+{
+  __sCriticalRegionBegin();
+  simpleRTOSTimeout *temp = __unlinkTimeout(NULL, timer, NULL);
   __sCriticalRegionEnd();
-  free(temp);
+  sRTOSFree(temp);
 }
 
 void _removeTaskTimeoutList(sTaskHandle_t *task)
 {
   __sCriticalRegionBegin();
-  if (__TimeoutList == NULL)
-  {
-    __sCriticalRegionEnd();
-    return;
-  }
+  simpleRTOSTimeout *temp = __unlinkTimeout(task, NULL, NULL);
+  __sCriticalRegionEnd();
+  sRTOSFree(temp);
+}
+
+void _removeCoroutineTimeoutList(sCoroutine_t *co)
+{
+  __sCriticalRegionBegin();
+  simpleRTOSTimeout *temp = __unlinkTimeout(NULL, NULL, co);
+  __sCriticalRegionEnd();
+  sRTOSFree(temp);
+}
+
+// puts co in the timeout list until tick deadline, returns sFalse if the timeout could not be allocated
+sbool_t _sInsertCoroutineTimeout(sCoroutine_t *co, sTick_t deadline)
+{
+  simpleRTOSTimeout *timeout = (simpleRTOSTimeout *)sRTOSMalloc(sizeof(simpleRTOSTimeout));
+  if (timeout == NULL)
+    return sFalse;
+
+  timeout->task = NULL;
+  timeout->timer = NULL;
+  timeout->coroutine = co;
+  timeout->dontRunUntil = deadline;
+  timeout->next = NULL;
+  _sInsertTimeout(timeout);
+  return sTrue;
+}
+
+// pulls forward the timers whose slack window [deadline, dontRunUntil] contains now,
+// so they expire in the same pass as the timeout that has just expired.
+// only timers that expire at most __sTIMER_MAX_SLACK ticks from now can be in the window.
+static void __coalesceTimers(sTick_t now)
+{
+  simpleRTOSTimeout *merged = NULL;
+  sTick_t horizon = now + __sTIMER_MAX_SLACK;
 
-  if (__TimeoutList->task == task)
+  __sCriticalRegionBegin();
+  simpleRTOSTimeout **link = &__TimeoutList;
+  while (*link != NULL && (*link)->dontRunUntil <= horizon)
   {
-    simpleRTOSTimeout *temp = __TimeoutList;
-    __TimeoutList = __TimeoutList->next;
-    __sCriticalRegionEnd();
-    free(temp);
-    return;
+    simpleRTOSTimeout *curr = *link;
+    if (curr->timer != NULL && curr->dontRunUntil > now && curr->deadline <= now)
+    {
+      *link = curr->next; // unlink, it is re-inserted as expired below
+      curr->next = merged;
+      merged = curr;
+    }
+    else
+    {
+      link = &curr->next;
+    }
   }
 
-  simpleRTOSTimeout *curr = __TimeoutList;
-  while (curr->next && curr->next->task != task)
+  while (merged != NULL)
   {
-    curr = curr->next;
+    simpleRTOSTimeout *curr = merged;
+    merged = merged->next;
+    curr->dontRunUntil = now;
+    _sInsertTimeout(curr);
+    __TimerStats.mergedExpiries++;
   }
-
-  simpleRTOSTimeout *temp = curr->next;
-  curr->next = temp->next;
   __sCriticalRegionEnd();
-  free(temp);
 }
 
 // function check for tasks and timer that are done wainting
 // it re-insert task that are done back to the ready taskList
 // for timer it re-insert them into the __TimeoutList if autoReload is on,
 // and then it returns them to tell the scheduler a time is ready to run
+// (with the timer daemon, expired timers are queued to the daemon and NULL is always returned)
 void *_sCheckExpiredTimeOut(void)
 {
+  sTick_t now = sGetTick();
+  if (__TimeoutList != NULL && __EarliestExpiringTimeout <= now && __LastTimerExpiryTick != now)
+  {
+    // first expiry pass of this tick
+    __LastTimerExpiryTick = now;
+    __TimerStats.expiryPasses++;
+    __coalesceTimers(now);
+  }
+
   while (__TimeoutList != NULL && __EarliestExpiringTimeout <= sGetTick())
   {
     __sCriticalRegionBegin();
     simpleRTOSTimeout *expiredTimeout = __popFirstDelay();
     if (expiredTimeout->task != NULL)
     {
+      expiredTimeout->task->status = sReady;
       _insertTask(expiredTimeout->task);
-      // _insertTask will exit critical region that why the __sCriticalRegionBegin(); is called in the loop
-      free(expiredTimeout);
+#if __sUSE_LATENCY_STATS == 1
+      _sLatencyReady(expiredTimeout->task);
+#endif
+      __sCriticalRegionEnd();
+      sRTOSFree(expiredTimeout);
     }
+#if __sUSE_COROUTINES == 1
+    else if (expiredTimeout->coroutine != NULL)
+    {
+      _sCoroutineTimeout(expiredTimeout->coroutine);
+      __sCriticalRegionEnd();
+      sRTOSFree(expiredTimeout);
+    }
+#endif
     else
     {
-      if (expiredTimeout->timer->autoReload == sTrue)
+      sTimerHandle_t *timer = expiredTimeout->timer;
+      if (timer->autoReload == sTrue)
       {
-        expiredTimeout->dontRunUntil = SAT_ADD_U32(expiredTimeout->dontRunUntil, expiredTimeout->timer->Period);
+        expiredTimeout->deadline += (sUBaseType_t)timer->Period;
+        expiredTimeout->dontRunUntil = expiredTimeout->deadline + timer->slack;
         _sInsertTimeout(expiredTimeout);
-        // _sInsertTimeout will exit critical region
+        __sCriticalRegionEnd();
       }
       else
       {
+        timer->status = sBlocked; // a one-shot timer can be restarted with sRTOSTimerResume
         __sCriticalRegionEnd();
-        free(expiredTimeout);
+        sRTOSFree(expiredTimeout);
       }
 
-      return expiredTimeout->timer;
+#if __sUSE_TIMER_DAEMON == 1
+      if (!_sTimerDaemonPush(timer))
+        __TimerStats.droppedExpiries++; // the daemon queue is full
+#else
+      _sTimerPrepareStack(timer);
+      return timer;
+#endif
     }
   }
 
   return NULL; // returning null means no timer to run
 }
 
+void sRTOSTimerGetStats(sTimerStats_t *stats)
+{
+  __sCriticalRegionBegin();
+  *stats = __TimerStats;
+  __sCriticalRegionEnd();
+}
+
 // only works on task not timers
 void sRTOSTaskDelay(sUBaseType_t duration_ms)
 {
-  sUBaseType_t temp = sGetTick();
-  simpleRTOSTimeout *delay = (simpleRTOSTimeout *)malloc(sizeof(simpleRTOSTimeout));
+  sTick_t temp = sGetTick();
+  simpleRTOSTimeout *delay = (simpleRTOSTimeout *)sRTOSMalloc(sizeof(simpleRTOSTimeout));
+  if (delay == NULL)
+  {
+    // the kernel heap is exhausted: the task polls, the delay is still respected
+    sTick_t deadline = temp + srMS_TO_TICKS(duration_ms);
+    while (sGetTick() < deadline)
+      sRTOSTaskYield();
+    return;
+  }
 
   delay->task = _sCurrentTask;
-  delay->dontRunUntil = SAT_ADD_U32(temp, (duration_ms * (__sRTOS_SENSIBILITY / 1000)));
+  delay->timer = NULL;
+  delay->coroutine = NULL;
+  delay->dontRunUntil = temp + srMS_TO_TICKS(duration_ms);
   delay->next = NULL;
 
   __sCriticalRegionBegin();
@@ -184,3 +308,119 @@ void sRTOSTaskDelay(sUBaseType_t duration_ms)
   __sCriticalRegionEnd();
   sRTOSTaskYield();
 }
+
+// removes the current task from the ready list until _sWakeTask is called or timeoutTicks pass.
+// a timeout of __sMAX_DELAY blocks without using the timeout list.
+// returns sFalse if the timeout could not be allocated (the task is not blocked).
+// note: the caller must yield after calling this function (outside of any critical region)
+sbool_t _sBlockCurrentTask(sUBaseType_t timeoutTicks)
+{
+  if (timeoutTicks == __sMAX_DELAY)
+  {
+    __sCriticalRegionBegin();
+    _sCurrentTask->status = sBlocked;
+    _deleteTask(_sCurrentTask, sFalse);
+    __sCriticalRegionEnd();
+    return sTrue;
+  }
+
+  sTick_t temp = sGetTick();
+  simpleRTOSTimeout *timeout = (simpleRTOSTimeout *)sRTOSMalloc(sizeof(simpleRTOSTimeout));
+  if (timeout == NULL)
+    return sFalse;
+
+  timeout->task = _sCurrentTask;
+  timeout->timer = NULL;
+  timeout->coroutine = NULL;
+  timeout->dontRunUntil = __sTickDeadline(temp, timeoutTicks);
+  timeout->next = NULL;
+
+  __sCriticalRegionBegin();
+  _sCurrentTask->status = sWaiting;
+  _deleteTask(_sCurrentTask, sFalse);
+  _sInsertTimeout(timeout);
+  __sCriticalRegionEnd();
+  return sTrue;
+}
+
+// puts a task blocked by _sBlockCurrentTask back into the ready list,
+// nothing happens if the task is already ready (for example its timeout has expired),
+// or if it was stopped by sRTOSTaskStop (only sRTOSTaskResume makes it ready again)
+void _sWakeTask(sTaskHandle_t *task)
+{
+  __sCriticalRegionBegin();
+  if (task->stopped)
+  {
+    __sCriticalRegionEnd();
+    return;
+  }
+
+  if (task->status == sWaiting)
+  {
+    _removeTaskTimeoutList(task);
+  }
+  else if (task->status != sBlocked)
+  {
+    __sCriticalRegionEnd();
+    return;
+  }
+
+  task->status = sReady;
+  _insertTask(task);
+#if __sUSE_LATENCY_STATS == 1
+  _sLatencyReady(task);
+#endif
+  __sCriticalRegionEnd();
+}
+
+// appends task at the end of a wait list (tasks are woken in arrival order).
+// the caller sets task->waitCount and task->waitHolder if the object has them
+void _sWaitListAppend(sTaskHandle_t **list, sTaskHandle_t *task)
+{
+  task->waitList = list;
+  task->waitCount = NULL;
+  task->waitHolder = NULL;
+
+  task->nextWaiter = NULL;
+  while (*list != NULL)
+  {
+    list = &(*list)->nextWaiter;
+  }
+  *list = task;
+}
+
+void _sWaitListRemove(sTaskHandle_t **list, sTaskHandle_t *task)
+{
+  while (*list != NULL && *list != task)
+  {
+    list = &(*list)->nextWaiter;
+  }
+
+  if (*list != NULL)
+  {
+    *list = task->nextWaiter;
+    task->nextWaiter = NULL;
+    task->waitList = NULL;
+  }
+}
+
+// unlinks a task that is deleted while blocked on an object: the object forgets the waiter,
+// the owner of a lock drops the priority it inherited from it, and the readers a
+// waiting writer held back are woken.
+// returns sTrue if a woken task has a higher priority than the current task.
+// note: must be called inside a critical region
+sbool_t _sWaitListForget(sTaskHandle_t *task)
+{
+  sTaskHandle_t **list = task->waitList;
+  if (list == NULL)
+    return sFalse;
+
+  _sWaitListRemove(list, task);
+  if (task->waitCount != NULL)
+    (*task->waitCount)--;
+  if (task->waitHolder != NULL && *task->waitHolder != NULL)
+    _sInheritFromWaiters(*task->waitHolder, *list);
+  if (task->exclusiveWait) // only set while blocked on a rwlock as a writer
+    return _sRwLockWriterForgotten(list);
+  return sFalse;
+}
@@ -8,54 +8,132 @@
 #include "simpleRTOS.h"
 #include "stdlib.h"
 
-extern void _deleteTask(sTaskHandle_t *task, sbool_t freeMem);
-extern void _insertTask(sTaskHandle_t *task);
+extern sbool_t _sBlockCurrentTask(sUBaseType_t timeoutTicks);
+extern void _sWakeTask(sTaskHandle_t *task);
 
 extern sTaskHandle_t *_sCurrentTask;
 
-void _pushTaskNotification(sTaskHandle_t *task, sUBaseType_t message, sPriority_t priority)
+// updates the slot, and wakes the task if it is waiting on it.
+// returns sFalse if the notification was not delivered (sNotifyOverwriteIfEmpty on a pending slot).
+// higherPriorityWoken is set if the woken task has a higher priority than the current task.
+static sbool_t _pushTaskNotification(sTaskHandle_t *task, sUBaseType_t index, sUBaseType_t message, sNotifyAction_t action, sbool_t *higherPriorityWoken)
 {
+  *higherPriorityWoken = sFalse;
+
+  if (index >= __sTASK_NOTIFICATION_SLOTS)
+    return sFalse;
+
   __sCriticalRegionBegin();
-  if (message != NULL)
+  sNotificationState_t state = task->notificationState[index];
+  switch (action)
   {
-    task->hasNotification = sTrue;
-    task->notificationMessage = message;
+  case sNotifySetBits:
+    task->notificationValue[index] |= message;
+    break;
+  case sNotifyIncrement:
+    task->notificationValue[index]++;
+    break;
+  case sNotifyOverwrite:
+    task->notificationValue[index] = message;
+    break;
+  case sNotifyOverwriteIfEmpty:
+    if (state == sNotificationPending)
+    {
+      __sCriticalRegionEnd();
+      return sFalse;
+    }
+    task->notificationValue[index] = message;
+    break;
+  default: // sNotifyNoAction
+    break;
   }
-  if (task->priority < priority)
+  task->notificationState[index] = sNotificationPending;
+
+  if (state == sNotificationWaiting)
   {
-    task->priority = priority;
-    _deleteTask(task, sFalse);
-    _insertTask(task);
+    *higherPriorityWoken = (sbool_t)(task->priority > _sCurrentTask->priority);
+    _sWakeTask(task);
   }
   __sCriticalRegionEnd();
+  return sTrue;
+}
+
+sbool_t sRTOSTaskNotifyIndexed(sTaskHandle_t *taskToNotify, sUBaseType_t index, sUBaseType_t message, sNotifyAction_t action)
+{
+  sbool_t yield;
+  sbool_t delivered = _pushTaskNotification(taskToNotify, index, message, action, &yield);
+  __sYieldIfWoken(yield);
+  return delivered;
+}
+
+sbool_t sRTOSTaskNotifyIndexedFromISR(sTaskHandle_t *taskToNotify, sUBaseType_t index, sUBaseType_t message, sNotifyAction_t action, sbool_t *higherPriorityWoken)
+{
+  sbool_t woken; // the woken task runs at the next tick, or when the ISR returns with sRTOSYieldFromISR
+  sbool_t delivered = _pushTaskNotification(taskToNotify, index, message, action, &woken);
+  __sReportWoken(higherPriorityWoken, woken);
+  return delivered;
 }
 
 void sRTOSTaskNotify(sTaskHandle_t *taskToNotify, sUBaseType_t message)
 {
-  _pushTaskNotification(taskToNotify, message, _sCurrentTask->priority);
+  sRTOSTaskNotifyIndexed(taskToNotify, 0, message, sNotifyOverwrite);
 }
 
-void sRTOSTaskNotifyFromISR(sTaskHandle_t *taskToNotify, sUBaseType_t message)
+void sRTOSTaskNotifyFromISR(sTaskHandle_t *taskToNotify, sUBaseType_t message, sbool_t *higherPriorityWoken)
 {
-  _pushTaskNotification(taskToNotify, message, sPriorityMax);
+  sRTOSTaskNotifyIndexedFromISR(taskToNotify, 0, message, sNotifyOverwrite, higherPriorityWoken);
 }
 
-sUBaseType_t sRTOSTaskNotifyTake(sUBaseType_t timeoutTicks)
+sUBaseType_t sRTOSTaskNotifyTakeIndexed(sUBaseType_t index, sbool_t clearOnExit, sUBaseType_t timeoutTicks)
 {
-  sUBaseType_t timeoutFinish = SAT_ADD_U32(sGetTick(), timeoutTicks);
+  if (index >= __sTASK_NOTIFICATION_SLOTS)
+    return 0;
+
   __sCriticalRegionBegin();
-  while (!_sCurrentTask->hasNotification)
+  if (_sCurrentTask->notificationState[index] != sNotificationPending)
   {
-    __sCriticalRegionEnd();
-    if (timeoutFinish <= sGetTick())
+    if (timeoutTicks == 0)
     {
-      return sFalse;
+      __sCriticalRegionEnd();
+      return 0;
+    }
+
+    // the task sleeps until it is notified or the timeout expires, it is not polled
+    _sCurrentTask->notificationState[index] = sNotificationWaiting;
+    if (_sBlockCurrentTask(timeoutTicks))
+    {
+      __sCriticalRegionEnd();
+      sRTOSTaskYield();
+      __sCriticalRegionBegin();
+    }
+
+    if (_sCurrentTask->notificationState[index] != sNotificationPending)
+    {
+      _sCurrentTask->notificationState[index] = sNotificationEmpty;
+      __sCriticalRegionEnd();
+      return 0; // timeout
     }
-    sRTOSTaskYield();
-    __sCriticalRegionBegin();
   }
-  _sCurrentTask->hasNotification = sFalse;
 
+  sUBaseType_t value = _sCurrentTask->notificationValue[index];
+  if (clearOnExit)
+  {
+    _sCurrentTask->notificationValue[index] = 0;
+    _sCurrentTask->notificationState[index] = sNotificationEmpty;
+  }
+  else
+  {
+    // counting semaphore: one unit is consumed, the slot stays pending while units are left
+    if (value != 0)
+      _sCurrentTask->notificationValue[index] = value - 1;
+    if (_sCurrentTask->notificationValue[index] == 0)
+      _sCurrentTask->notificationState[index] = sNotificationEmpty;
+  }
   __sCriticalRegionEnd();
-  return _sCurrentTask->notificationMessage;
+  return value;
+}
+
+sUBaseType_t sRTOSTaskNotifyTake(sUBaseType_t timeoutTicks)
+{
+  return sRTOSTaskNotifyTakeIndexed(0, sTrue, timeoutTicks);
 }
@@ -12,7 +12,9 @@ typedef struct simpleRTOSTimeout
 {
   sTaskHandle_t *task; // set null
   sTimerHandle_t *timer;
-  sUBaseType_t dontRunUntil; // time in ticks where the timer can start running
+  sCoroutine_t *coroutine;
+  sTick_t dontRunUntil; // time in ticks where the timer can start running
+  sTick_t deadline;     // timers only: nominal expiry, dontRunUntil is the deadline plus the timer slack
   struct simpleRTOSTimeout *next;
 } simpleRTOSTimeout;
 
@@ -21,6 +23,67 @@ extern void _removeTimerTimeoutList(sTimerHandle_t *timer);
 
 extern volatile sUBaseType_t _sIsTimerRunning;
 
+#if __sUSE_TIMER_DAEMON == 1
+extern sbool_t _sBlockCurrentTask(sUBaseType_t timeoutTicks);
+extern void _sWakeTask(sTaskHandle_t *task);
+
+sTaskHandle_t __TimerDaemonTask;
+static sTimerHandle_t *__TimerQueue[__sTIMER_QUEUE_LENGTH];
+static volatile sUBaseType_t __TimerQueueHead = 0; // only written by the daemon
+static volatile sUBaseType_t __TimerQueueTail = 0; // only written by SysTick
+static volatile sbool_t __TimerDaemonIdle = sFalse;  // the daemon is blocked waiting for the queue (not inside a callback)
+
+// called by SysTick for every expired timer, the callback is run later by the daemon task.
+// returns sFalse if the queue is full (the expiration is dropped)
+sbool_t _sTimerDaemonPush(sTimerHandle_t *timerHandle)
+{
+  sUBaseType_t next = (__TimerQueueTail + 1) % __sTIMER_QUEUE_LENGTH;
+  if (next == __TimerQueueHead)
+    return sFalse;
+
+  __TimerQueue[__TimerQueueTail] = timerHandle;
+  __TimerQueueTail = next;
+  if (__TimerDaemonIdle)
+  {
+    __TimerDaemonIdle = sFalse;
+    _sWakeTask(&__TimerDaemonTask);
+  }
+  return sTrue;
+}
+
+static void _timerDaemon(void *)
+{
+  for (;;)
+  {
+    __sCriticalRegionBegin();
+    if (__TimerQueueHead == __TimerQueueTail)
+    {
+      // checking the queue and blocking are done in the same critical region so a push can not be missed
+      __TimerDaemonIdle = sTrue;
+      _sBlockCurrentTask(__sMAX_DELAY);
+      __sCriticalRegionEnd();
+      sRTOSTaskYield();
+      continue;
+    }
+    __sCriticalRegionEnd();
+
+    sTimerHandle_t *timerHandle = __TimerQueue[__TimerQueueHead];
+    __TimerQueueHead = (__TimerQueueHead + 1) % __sTIMER_QUEUE_LENGTH;
+    timerHandle->callback(timerHandle);
+  }
+}
+
+sRTOS_StatusTypeDef _sTimerDaemonCreate(void)
+{
+  return sRTOSTaskCreate(_timerDaemon,
+                         "timer daemon",
+                         NULL,
+                         __sTIMER_DAEMON_STACK_DEPTH,
+                         __sTIMER_DAEMON_PRIORITY,
+                         &__TimerDaemonTask,
+                         srFALSE);
+}
+#else
 __STATIC_FORCEINLINE__ void _timerReturn(void *)
 {
   _sIsTimerRunning = 0;
@@ -32,30 +95,41 @@ __STATIC_FORCEINLINE__ void _timerReturn(void *)
 __STATIC_NAKED__ void _timerStart(sTimerHandle_t *, sTimerFunc_t timerTask)
 {
   __asm volatile(
-      "sub  sp, #32 \n" // to keep the register that restore the context unchanged and reusable
       "bx   r1      \n" // timerTask is the second argument thus stored in r1
       ::: "memory");
 }
 
-void __insertTimer(sTimerHandle_t *timerHandle)
+// callbacks run one at a time and to completion (guarded by _sIsTimerRunning),
+// so every timer shares this stack (its base is the stack limit of the callbacks on ARMv8-M).
+sUBaseType_t __TimerStack[CONTEXT_STACK_SIZE + __sTIMER_TASK_STACK_DEPTH] __attribute__((aligned(8)));
+#endif
+
+// returns sFalse if the timeout could not be allocated (the timer is not armed)
+static sbool_t __insertTimer(sTimerHandle_t *timerHandle)
 {
-  sUBaseType_t temp = sGetTick();
-  simpleRTOSTimeout *delay = (simpleRTOSTimeout *)malloc(sizeof(simpleRTOSTimeout));
+  sTick_t temp = sGetTick();
+  simpleRTOSTimeout *delay = (simpleRTOSTimeout *)sRTOSMalloc(sizeof(simpleRTOSTimeout));
+  if (delay == NULL)
+    return sFalse;
 
   delay->task = NULL;
   delay->timer = timerHandle;
-  delay->dontRunUntil = SAT_ADD_U32(temp, timerHandle->Period);
+  delay->coroutine = NULL;
+  delay->deadline = temp + (sUBaseType_t)timerHandle->Period;
+  delay->dontRunUntil = delay->deadline + timerHandle->slack;
   delay->next = NULL;
 
   _sInsertTimeout(delay);
+  return sTrue;
 }
 
-static sUBaseType_t *__taskInitStackTimer(sTimerFunc_t timerFunc, sTimerHandle_t *arg)
+#if __sUSE_TIMER_DAEMON == 0
+// builds the exception frame that starts timerHandle's callback at the top of the shared timer stack,
+// called by SysTick right before it switches to the timer
+void _sTimerPrepareStack(sTimerHandle_t *timerHandle)
 {
   sUBaseType_t stacksize = CONTEXT_STACK_SIZE + __sTIMER_TASK_STACK_DEPTH;
-  sUBaseType_t *stack = (sUBaseType_t *)malloc(sizeof(sUBaseType_t) * (stacksize));
-  if (stack == NULL)
-    return NULL;
+  sUBaseType_t *stack = __TimerStack;
 
   /*
   Hardware automatically pushes these registers onto the stack (in this order):
@@ -69,32 +143,22 @@ static sUBaseType_t *__taskInitStackTimer(sTimerFunc_t timerFunc, sTimerHandle_t
       xPSR (program status register)
 */
 
-  stack[stacksize - 8] = (sUBaseType_t)arg;            // R0
-  stack[stacksize - 7] = (sUBaseType_t)(timerFunc);    // R1
-  stack[stacksize - 3] = (sUBaseType_t)(_timerReturn); // LR
+  stack[stacksize - 8] = (sUBaseType_t)timerHandle;            // R0
+  stack[stacksize - 7] = (sUBaseType_t)(timerHandle->callback); // R1
+  stack[stacksize - 3] = (sUBaseType_t)(_timerReturn);         // LR
   // The task address is set in the PC register
   stack[stacksize - 2] = (sUBaseType_t)(_timerStart); // PC
   // set to Thumb mode
   stack[stacksize - 1] = 0x01000000; // xPSR
 
 #ifdef DEBUG
-  stack[stacksize - 6] = 0x22222223;  // R2
-  stack[stacksize - 5] = 0x33333334;  // R3
-  stack[stacksize - 4] = 0xCCCCCCCE;  // R12
-  stack[stacksize - 9] = 0x77777778;  // r7
-  stack[stacksize - 10] = 0x66666667; // r6
-  stack[stacksize - 11] = 0x55555556; // r5
-  stack[stacksize - 12] = 0x44444445; // r4
-  stack[stacksize - 13] = 0xBBBBBBBC; // r11
-  stack[stacksize - 14] = 0xAAAAAAAB; // r10
-  stack[stacksize - 15] = 0x9999999A; // r9
-  stack[stacksize - 16] = 0x88888889; // r8
-
-  // stack[stacksize - 17] = 0xEEEEEEEE; // s31
-  // stack[stacksize - 18] = 0xFFFFFFFF; // s32
+  stack[stacksize - 6] = 0x22222223; // R2
+  stack[stacksize - 5] = 0x33333334; // R3
+  stack[stacksize - 4] = 0xCCCCCCCE; // R12
 #endif
-  return stack;
+  timerHandle->stackPt = &stack[stacksize - 8];
 }
+#endif
 
 sRTOS_StatusTypeDef sRTOSTimerCreate(
     sTimerFunc_t timerTask,
@@ -103,19 +167,19 @@ sRTOS_StatusTypeDef sRTOSTimerCreate(
     sUBaseType_t autoReload,
     sTimerHandle_t *timerHandle)
 {
-  // using this function thier is 7 words added to save r4-r11
-  sUBaseType_t *stack = __taskInitStackTimer(timerTask, (void *)timerHandle);
-  if (stack == NULL)
-    return sRTOS_ALLOCATION_FAILED;
-
-  timerHandle->stackPt = (sUBaseType_t *)(stack + __sTIMER_TASK_STACK_DEPTH); // no need to restore r4-r11
-  timerHandle->stackBase = (sUBaseType_t *)stack;
+  timerHandle->stackPt = NULL; // set when the callback is started (shared timer stack)
+  timerHandle->callback = timerTask;
   timerHandle->id = id;
   timerHandle->Period = period;
   timerHandle->autoReload = (sbool_t)autoReload;
   timerHandle->status = sReady;
+  timerHandle->slack = 0;
 
-  __insertTimer(timerHandle);
+  if (!__insertTimer(timerHandle))
+  {
+    timerHandle->status = sBlocked; // can be armed later with sRTOSTimerResume
+    return sRTOS_ALLOCATION_FAILED;
+  }
   return sRTOS_OK;
 }
 
@@ -123,39 +187,59 @@ sRTOS_StatusTypeDef sRTOSTimerCreate(
 // stop will prevent the timer from running again, until resumed
 void sRTOSTimerStop(sTimerHandle_t *timerHandle)
 {
+  __sCriticalRegionBegin();
   if (timerHandle->status == sReady)
   {
-    __sCriticalRegionBegin();
     timerHandle->status = sBlocked;
     _removeTimerTimeoutList(timerHandle);
   }
+  __sCriticalRegionEnd();
 }
 
-void sRTOSTimerResume(sTimerHandle_t *timerHandle)
+sRTOS_StatusTypeDef sRTOSTimerResume(sTimerHandle_t *timerHandle)
 {
+  sRTOS_StatusTypeDef status = sRTOS_OK;
+
+  __sCriticalRegionBegin();
   if (timerHandle->status == sBlocked)
   {
-    __sCriticalRegionBegin();
-    timerHandle->status = sReady;
-    __insertTimer(timerHandle);
+    if (__insertTimer(timerHandle))
+      timerHandle->status = sReady;
+    else
+      status = sRTOS_ALLOCATION_FAILED;
   }
+  __sCriticalRegionEnd();
+  return status;
 }
 
 // If a NULL or invalid timerHandle is provided, no action is taken.
 // If a timer deletes itself or is deleted from an ISR,
 // the timer continues executing until it returns.
-// Deleting while the timer is still running causes use-after-free,
-// Do NOT delete a timer until the timer is no longer in use (Because it memory is freed).
+// The callback runs on the shared timer stack, so a timer can delete itself,
+// but the handle must stay valid until the callback returns.
+// With the timer daemon, this includes an expiration still waiting in the daemon queue.
 void sRTOSTimerDelete(sTimerHandle_t *timerHandle)
 {
   _removeTimerTimeoutList(timerHandle);
-  free(timerHandle->stackBase);
 }
 
-void sRTOSTimerUpdatePeriod(sTimerHandle_t *timerHandle, sBaseType_t period)
+sRTOS_StatusTypeDef sRTOSTimerUpdatePeriod(sTimerHandle_t *timerHandle, sBaseType_t period)
 {
+  sRTOS_StatusTypeDef status = sRTOS_OK;
+
   __sCriticalRegionBegin();
   timerHandle->Period = period;
   _removeTimerTimeoutList(timerHandle);
-  __insertTimer(timerHandle);
+  if (!__insertTimer(timerHandle))
+  {
+    timerHandle->status = sBlocked; // stopped, sRTOSTimerResume arms it again
+    status = sRTOS_ALLOCATION_FAILED;
+  }
+  __sCriticalRegionEnd();
+  return status;
+}
+
+void sRTOSTimerSetSlack(sTimerHandle_t *timerHandle, sUBaseType_t slackTicks)
+{
+  timerHandle->slack = (slackTicks > __sTIMER_MAX_SLACK) ? __sTIMER_MAX_SLACK : slackTicks;
 }
@@ -0,0 +1,387 @@
+#!/usr/bin/env python3
+#
+# sRTOSgen.py
+#
+#  Created on: Oct 19, 2026
+#      Author: brachiGH
+#
+# Generates the kernel objects of a static configuration (__sUSE_STATIC_CONFIG == 1):
+# task control blocks, stacks, ready lists, priority bitmap, queues, semaphores and mutexes
+# are emitted as initialised data, so the system starts without any runtime creation or malloc.
+# It also prints a RAM report and a fixed-priority response time analysis of the periodic tasks.
+#
+# usage: python3 tools/sRTOSgen.py config.json [-o outdir] [--strict]
+#
+# config.json (comments are only explanations, see example/staticConfig.json):
+# {
+#   "tick_hz": 2000,                                 // __sRTOS_SENSIBILITY, used by the report
+#   "idle_stack_words": 12,
+#   "tasks": [
+#     { "name": "sensorTask",                        // sTaskHandle_t symbol
+#       "function": "SensorTask",                    // void SensorTask(void *)
+#       "arg": "NULL",                               // C expression, optional
+#       "stack_words": 128,
+#       "priority": "sPriorityHigh",                 // enum name or -16..15
+#       "fpu": false,
+#       "period_us": 1000, "wcet_us": 120, "deadline_us": 1000 }   // optional, for the report
+#   ],
+#   "queues": [ { "name": "sampleQueue", "length": 8, "item_size": 16 } ],
+#   "semaphores": [ { "name": "dataReady", "count": 0 } ],
+#   "mutexes": [ { "name": "busLock" } ]
+# }
+
+import argparse
+import json
+import math
+import os
+import sys
+
+MAX_TASK_PRIORITY_COUNT = 32
+MAX_TASK_NAME_LEN = 12
+MIN_STACK_SIZE_NO_FPU = 16
+MIN_STACK_SIZE_FPU = 49
+STACK_LIMIT_GUARD_WORDS = 24  # ARMv8-M only, STACK_LIMIT_GUARD_WORDS in simpleRTOSDefinitions.h
+
+PRIORITIES = {
+    "sPriorityIdle": -16,
+    "sPriorityLow": -2,
+    "sPriorityBelowNormal": -1,
+    "sPriorityNormal": 0,
+    "sPriorityAboveNormal": 1,
+    "sPriorityHigh": 2,
+    "sPriorityRealtime": 15,
+}
+
+
+class ConfigError(Exception):
+    pass
+
+
+def parse_priority(value, owner):
+    priority = PRIORITIES.get(value, value) if isinstance(value, str) else value
+    if not isinstance(priority, int) or not -16 <= priority <= 15:
+        raise ConfigError("%s: priority must be between -16 and 15 (got %r)" % (owner, value))
+    return priority
+
+
+def load_tasks(config):
+    tasks = [{
+        "name": "__sIdleTaskTCB",
+        "label": "idle task",
+        "function": "_idle",
+        "arg": "NULL",
+        "stack_words": config.get("idle_stack_words", 12),
+        "priority": PRIORITIES["sPriorityIdle"],
+        "fpu": False,
+        "period_us": None,
+        "wcet_us": None,
+        "deadline_us": None,
+    }]
+
+    for entry in config.get("tasks", []):
+        name = entry["name"]
+        task = {
+            "name": name,
+            "label": entry.get("label", name)[:MAX_TASK_NAME_LEN - 1],
+            "function": entry["function"],
+            "arg": entry.get("arg", "NULL"),
+            "stack_words": int(entry["stack_words"]),
+            "priority": parse_priority(entry.get("priority", "sPriorityNormal"), name),
+            "fpu": bool(entry.get("fpu", False)),
+            "period_us": entry.get("period_us"),
+            "wcet_us": entry.get("wcet_us"),
+        }
+        task["deadline_us"] = entry.get("deadline_us", task["period_us"])
+        tasks.append(task)
+
+    names = set()
+    for task in tasks:
+        if task["name"] in names:
+            raise ConfigError("%s is defined twice" % task["name"])
+        names.add(task["name"])
+
+        # same layout as _taskInitStack: the task stack, then the first context frame.
+        # the total is rounded to an even number of words so the stack top stays 8 bytes aligned
+        frame = MIN_STACK_SIZE_FPU if task["fpu"] else MIN_STACK_SIZE_NO_FPU
+        task["stack_words"] += (task["stack_words"] + frame) % 2
+        task["total_words"] = task["stack_words"] + frame
+        task["index"] = task["priority"] + MAX_TASK_PRIORITY_COUNT // 2
+    return tasks
+
+
+def ready_lists(tasks):
+    lists = {}
+    for task in tasks:
+        lists.setdefault(task["index"], []).append(task)
+
+    # circular doubly linked list per priority, in declaration order
+    for members in lists.values():
+        for i, task in enumerate(members):
+            task["next"] = members[(i + 1) % len(members)]["name"]
+            task["prev"] = members[i - 1]["name"]
+    return lists
+
+
+def response_times(tasks):
+    """Response time analysis for fixed priorities, a task is interfered with by every task
+    of higher or equal priority (equal priorities are rotated every quantum)."""
+    results = []
+    for task in tasks:
+        if task["period_us"] is None or task["wcet_us"] is None:
+            continue
+
+        interferers = [t for t in tasks if t is not task and t["priority"] >= task["priority"]]
+        unbounded = [t["name"] for t in interferers if t["period_us"] is None or t["wcet_us"] is None]
+        if unbounded:
+            results.append((task, None, "unbounded interference from " + ", ".join(unbounded)))
+            continue
+
+        response = task["wcet_us"]
+        while True:
+            nextResponse = task["wcet_us"] + sum(math.ceil(response / t["period_us"]) * t["wcet_us"]
+                                                 for t in interferers)
+            if nextResponse == response or nextResponse > task["deadline_us"]:
+                response = nextResponse
+                break
+            response = nextResponse
+
+        status = "ok" if response <= task["deadline_us"] else "DEADLINE MISS"
+        results.append((task, response, status))
+    return results
+
+
+def report(config, tasks, queues, lists):
+    lines = []
+    tick_hz = config.get("tick_hz", 2000)
+
+    stack_bytes = sum(t["total_words"] * 4 for t in tasks)
+    queue_bytes = sum(q["length"] * q["item_size"] for q in queues)
+    lines.append("RAM")
+    for task in tasks:
+        lines.append("  %-20s stack %6d bytes (%d words + %d words first frame), +%d bytes on ARMv8-M"
+                     % (task["name"], task["total_words"] * 4, task["stack_words"],
+                        task["total_words"] - task["stack_words"], STACK_LIMIT_GUARD_WORDS * 4))
+    for queue in queues:
+        lines.append("  %-20s queue %6d bytes (%d x %d)"
+                     % (queue["name"], queue["length"] * queue["item_size"], queue["length"], queue["item_size"]))
+    lines.append("  stacks %d bytes (%d bytes on ARMv8-M), queue storage %d bytes, plus %d x sizeof(sTaskHandle_t)"
+                 % (stack_bytes, stack_bytes + len(tasks) * STACK_LIMIT_GUARD_WORDS * 4, queue_bytes, len(tasks)))
+    lines.append("  (sRTOS_STATIC_RAM_BYTES in sRTOSStaticConfig.h gives the exact total)")
+
+    lines.append("")
+    lines.append("Ready lists")
+    for index in sorted(lists, reverse=True):
+        lines.append("  priority %3d: %s" % (index - MAX_TASK_PRIORITY_COUNT // 2,
+                                              ", ".join(t["name"] for t in lists[index])))
+
+    lines.append("")
+    lines.append("Schedulability (tick %d Hz, response times in us)" % tick_hz)
+    results = response_times(tasks)
+    periodic = [t for t in tasks if t["period_us"] is not None and t["wcet_us"] is not None]
+    failed = False
+    if not results:
+        lines.append("  no task declares period_us and wcet_us")
+    else:
+        utilization = sum(t["wcet_us"] / t["period_us"] for t in periodic)
+        bound = len(periodic) * (2 ** (1.0 / len(periodic)) - 1)
+        lines.append("  utilization %.3f (Liu & Layland bound %.3f)" % (utilization, bound))
+        for task, response, status in results:
+            if response is None:
+                lines.append("  %-20s %s" % (task["name"], status))
+                failed = True
+                continue
+            lines.append("  %-20s C=%-6d T=%-7d D=%-7d R=%-7d %s"
+                         % (task["name"], task["wcet_us"], task["period_us"], task["deadline_us"], response, status))
+            failed = failed or status != "ok"
+    return lines, stack_bytes, queue_bytes, failed
+
+
+def emit_source(path, source_name, tasks, queues, semaphores, mutexes, lists):
+    out = []
+    out.append("/*")
+    out.append(" * sRTOSStaticConfig.c")
+    out.append(" *")
+    out.append(" * Generated by tools/sRTOSgen.py from %s, do not edit." % source_name)
+    out.append(" */")
+    out.append("")
+    out.append('#include "simpleRTOS.h"')
+    out.append('#include "sRTOSStaticConfig.h"')
+    out.append("")
+    out.append("#if __sUSE_STATIC_CONFIG != 1")
+    out.append('#error "sRTOSStaticConfig.c is only used when __sUSE_STATIC_CONFIG is set to 1"')
+    out.append("#endif")
+    out.append("")
+    out.append("extern void _taskReturn(void *);")
+    for function in sorted(set(t["function"] for t in tasks)):
+        out.append("extern void %s(void *);" % function)
+    out.append("extern sTaskHandle_t __sIdleTaskTCB;")
+    out.append("")
+
+    # stacks stay in .bss, a stack initialised in C would be copied from flash in full at boot.
+    # the guard words (ARMv8-M) sit below the task stack, under the hardware stack limit
+    for task in tasks:
+        out.append("static sUBaseType_t __sStack_%s[STACK_LIMIT_GUARD_WORDS + %d] __attribute__((aligned(8)));"
+                   % (task["name"], task["total_words"]))
+    out.append("")
+
+    for task in tasks:
+        out.append("sTaskHandle_t %s = {" % task["name"])
+        if task["fpu"]:
+            # ARMv8-M starts every task with a basic frame, fps is set when an FPU frame is saved
+            out.append("#if defined(__ARM_ARCH_8M_MAIN__)")
+            out.append("    .stackPt = &__sStack_%s[STACK_LIMIT_GUARD_WORDS + %d]," % (task["name"], task["total_words"] - MIN_STACK_SIZE_NO_FPU))
+            out.append("    .fps = sFalse,")
+            out.append("#else")
+            out.append("    .stackPt = &__sStack_%s[STACK_LIMIT_GUARD_WORDS + %d]," % (task["name"], task["stack_words"]))
+            out.append("    .fps = sTrue,")
+            out.append("#endif")
+        else:
+            out.append("    .stackPt = &__sStack_%s[STACK_LIMIT_GUARD_WORDS + %d]," % (task["name"], task["stack_words"]))
+            out.append("    .fps = sFalse,")
+        out.append("    .nextTask = &%s," % task["next"])
+        out.append("    .status = sReady,")
+        out.append("    .priority = %d," % task["priority"])
+        out.append("    .regitersSaved = sTrue,")
+        out.append("    .stackBase = __sStack_%s," % task["name"])
+        out.append("    .prevTask = &%s," % task["prev"])
+        out.append("    .originalPriority = %d," % task["priority"])
+        out.append('    .name = "%s",' % task["label"])
+        out.append("    .inheritedPriority = sPriorityMin,")
+        out.append("    .isStatic = sTrue,")
+        out.append("};")
+    out.append("")
+
+    out.append("sTaskHandle_t *__IdleTask = &__sIdleTaskTCB;")
+    out.append("")
+    bitmap = 0
+    for index in lists:
+        bitmap |= 1 << index
+    out.append("volatile sUBaseType_t __TaskPriorityBitMap = 0x%08Xu;" % bitmap)
+    out.append("sTaskHandle_t *_sTaskList[MAX_TASK_PRIORITY_COUNT] = {")
+    for index in sorted(lists):
+        out.append("    [%d] = &%s," % (index, lists[index][0]["name"]))
+    out.append("};")
+    out.append("sUBaseType_t _sNumberOfReadyTaskPerPriority[MAX_TASK_PRIORITY_COUNT] = {")
+    for index in sorted(lists):
+        out.append("    [%d] = %d," % (index, len(lists[index])))
+    out.append("};")
+    out.append("")
+
+    for queue in queues:
+        out.append("static uint8_t __sQueueStorage_%s[%d] __attribute__((aligned(4)));"
+                   % (queue["name"], queue["length"] * queue["item_size"]))
+        out.append("sQueueHandle_t %s = {.maxLenght = %d, .lenght = 0, .itemSize = %d, .readIndex = 0, .storage = __sQueueStorage_%s};"
+                   % (queue["name"], queue["length"], queue["item_size"], queue["name"]))
+    for semaphore in semaphores:
+        out.append("sSemaphore_t %s = {.count = %d, .waiters = 0, .waitList = NULL};"
+                   % (semaphore["name"], semaphore.get("count", 0)))
+    for mutex in mutexes:
+        out.append("sMutex_t %s = {.holderHandle = NULL, .waiters = 0, .waitList = NULL};" % mutex["name"])
+    if queues or semaphores or mutexes:
+        out.append("")
+
+    out.append("// called by sRTOSInit: writes the hardware frame popped by the first switch to each task")
+    out.append("// (r0 = arg, lr = _taskReturn, pc = task, xPSR = thumb), the other registers start at 0")
+    out.append("// and names the queues, semaphores and mutexes in the object registry")
+    out.append("void _sStaticKernelInit(void)")
+    out.append("{")
+    for task in tasks:
+        stack = "__sStack_%s" % task["name"]
+        top = task["total_words"]
+        out.append("  %s[STACK_LIMIT_GUARD_WORDS + %d] = (sUBaseType_t)(%s);" % (stack, top - 8, task["arg"]))
+        out.append("  %s[STACK_LIMIT_GUARD_WORDS + %d] = (sUBaseType_t)(_taskReturn);" % (stack, top - 3))
+        out.append("  %s[STACK_LIMIT_GUARD_WORDS + %d] = (sUBaseType_t)(%s);" % (stack, top - 2, task["function"]))
+        out.append("  %s[STACK_LIMIT_GUARD_WORDS + %d] = 0x01000000;" % (stack, top - 1))
+    if queues or semaphores or mutexes:
+        out.append("#if __sUSE_OBJECT_STATS == 1")
+        for queue in queues:
+            out.append("  sRTOSObjectRegister(&%s, sObjectQueue, \"%s\");" % (queue["name"], queue["name"]))
+        for semaphore in semaphores:
+            out.append("  sRTOSObjectRegister(&%s, sObjectSemaphore, \"%s\");" % (semaphore["name"], semaphore["name"]))
+        for mutex in mutexes:
+            out.append("  sRTOSObjectRegister(&%s, sObjectMutex, \"%s\");" % (mutex["name"], mutex["name"]))
+        out.append("#endif")
+    out.append("}")
+
+    with open(path, "w") as f:
+        f.write("\n".join(out) + "\n")
+
+
+def emit_header(path, source_name, tasks, queues, semaphores, mutexes, stack_bytes, queue_bytes, report_lines):
+    out = []
+    out.append("/*")
+    out.append(" * sRTOSStaticConfig.h")
+    out.append(" *")
+    out.append(" * Generated by tools/sRTOSgen.py from %s, do not edit." % source_name)
+    out.append(" *")
+    for line in report_lines:
+        out.append((" * " + line).rstrip())
+    out.append(" */")
+    out.append("")
+    out.append("#ifndef SRTOSSTATICCONFIG_H_")
+    out.append("#define SRTOSSTATICCONFIG_H_")
+    out.append("")
+    out.append('#include "simpleRTOS.h"')
+    out.append("")
+    for task in tasks[1:]:
+        out.append("extern sTaskHandle_t %s;" % task["name"])
+    for queue in queues:
+        out.append("extern sQueueHandle_t %s;" % queue["name"])
+    for semaphore in semaphores:
+        out.append("extern sSemaphore_t %s;" % semaphore["name"])
+    for mutex in mutexes:
+        out.append("extern sMutex_t %s;" % mutex["name"])
+    out.append("")
+    out.append("#define sRTOS_STATIC_STACK_BYTES (%du + %d * 4 * STACK_LIMIT_GUARD_WORDS)" % (stack_bytes, len(tasks)))
+    out.append("#define sRTOS_STATIC_QUEUE_BYTES %du" % queue_bytes)
+    out.append("#define sRTOS_STATIC_RAM_BYTES (sRTOS_STATIC_STACK_BYTES + sRTOS_STATIC_QUEUE_BYTES \\")
+    out.append("                                + %d * sizeof(sTaskHandle_t) + %d * sizeof(sQueueHandle_t) \\"
+               % (len(tasks), len(queues)))
+    out.append("                                + %d * sizeof(sSemaphore_t) + %d * sizeof(sMutex_t))"
+               % (len(semaphores), len(mutexes)))
+    out.append("")
+    out.append("#endif")
+
+    with open(path, "w") as f:
+        f.write("\n".join(out) + "\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="generate the static kernel configuration of simpleRTOS")
+    parser.add_argument("config", help="json configuration")
+    parser.add_argument("-o", "--outdir", default=".", help="directory of sRTOSStaticConfig.c/.h")
+    parser.add_argument("--strict", action="store_true", help="fail if a deadline can be missed")
+    args = parser.parse_args()
+
+    with open(args.config) as f:
+        config = json.load(f)
+
+    try:
+        tasks = load_tasks(config)
+        queues = config.get("queues", [])
+        semaphores = config.get("semaphores", [])
+        mutexes = config.get("mutexes", [])
+        for queue in queues:
+            if int(queue["length"]) <= 0 or int(queue["item_size"]) <= 0:
+                raise ConfigError("%s: length and item_size must be positive" % queue["name"])
+    except (ConfigError, KeyError) as error:
+        print("sRTOSgen: %s" % error, file=sys.stderr)
+        return 1
+
+    lists = ready_lists(tasks)
+    report_lines, stack_bytes, queue_bytes, failed = report(config, tasks, queues, lists)
+    source_name = os.path.basename(args.config)
+
+    emit_source(os.path.join(args.outdir, "sRTOSStaticConfig.c"), source_name, tasks, queues, semaphores, mutexes, lists)
+    emit_header(os.path.join(args.outdir, "sRTOSStaticConfig.h"), source_name, tasks, queues, semaphores, mutexes,
+                stack_bytes, queue_bytes, report_lines)
+    print("\n".join(report_lines))
+
+    if failed and args.strict:
+        print("sRTOSgen: the task set is not schedulable", file=sys.stderr)
+        return 2
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())